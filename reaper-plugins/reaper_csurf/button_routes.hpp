@@ -0,0 +1,66 @@
+#ifndef _BUTTON_ROUTES_HPP_
+#define _BUTTON_ROUTES_HPP_
+
+namespace ReaMCULive
+{
+
+// Handler of incoming button notes evt_min ... evt_max, F is surface's
+// member function pointer type
+template <class F> struct ButtonHandler
+{
+  unsigned int evt_min;
+  unsigned int evt_max; // inclusive
+  F func;
+  F func_dc;
+};
+
+// Resolved handling of incoming button note, see ResolveButtonRoutes
+template <class F> struct ButtonRoute
+{
+  unsigned char code; // after remap
+  bool passthrough;
+  bool press_only;
+  F press;    // press only buttons, single click
+  F press_dc; // press only buttons, double click
+  F any;      // other buttons, press and release
+};
+
+// Folds remap, passthrough, press only flags and handler ranges into one
+// entry per note, routes has 256. First nPressOnly handlers are for press
+// only buttons. Call when any of them changes.
+template <class F>
+static void ResolveButtonRoutes(ButtonRoute<F>* routes,
+                                const ButtonHandler<F>* handlers,
+                                int nHandlers, int nPressOnly,
+                                const int* remap, const int* passthrough,
+                                const int* press_only)
+{
+  for (int x = 0; x < 256; x++)
+  {
+    ButtonRoute<F>* r = &routes[x];
+    r->code = remap[x] ? (unsigned char)remap[x] : (unsigned char)x;
+    r->passthrough = !!passthrough[r->code];
+    r->press_only = !!press_only[r->code];
+    r->press = NULL;
+    r->press_dc = NULL;
+    r->any = NULL;
+
+    // ranges overlap only as dc/single pairs, first match kept
+    for (int i = 0; i < nHandlers; i++)
+    {
+      const ButtonHandler<F>* bh = &handlers[i];
+      if (bh->evt_min > r->code || r->code > bh->evt_max)
+        continue;
+      if (!r->press_dc)
+        r->press_dc = bh->func_dc;
+      if (!r->press)
+        r->press = bh->func;
+      if (!r->any && i >= nPressOnly)
+        r->any = bh->func;
+    }
+  }
+}
+
+} // namespace ReaMCULive
+
+#endif
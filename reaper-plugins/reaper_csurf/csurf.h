@@ -8,6 +8,7 @@
 #include "../../WDL/wdlstring.h"
 #include "../../WDL/win32_utf8.h"
 #include "resource.h"
+#include <stddef.h>
 #include <stdio.h>
 
 namespace ReaMCULive
@@ -84,9 +85,79 @@ enum AutoMode
       (x)->Destroy();                                                          \
   } while (0)
 
+// largest message the queue carries, e.g. full 2x56 char LCD SysEx
+#define MIDIOUT_SLOT_SIZE 256
+// longer messages are dropped by threaded output SendMsg()
+#define MIDIOUT_MAX_MESSAGE                                                    \
+  (MIDIOUT_SLOT_SIZE - (int)offsetof(MIDI_event_t, midi_message))
+// short messages sent ahead of a waiting SysEx before it goes next
+#define MIDIOUT_SYSEX_MAX_BYPASS 32
+
 midi_Output* CreateThreadedMIDIOutput(
   midi_Output* output); // returns null on null
 
+// threaded output without device, e.g. for capture
+midi_Output* CreateVirtualMIDIOutput();
+
+struct MIDIOutputStats
+{
+  unsigned int sent;
+  unsigned int bytes;
+  unsigned int dropped; // queue full, message not sent
+  unsigned int coalesced; // replaced by newer value before sent
+  unsigned int queued;  // pending in queue
+  unsigned int enqueued; // passed to SendMsg(), incl. dropped/coalesced
+  unsigned int enqueued_bytes;
+  unsigned int queued_max; // high-water mark of queued
+
+  // enqueue-to-wire, seconds. see SetThreadedMIDIOutputLatencyMode
+  unsigned int latency_cnt;
+  double latency_avg;
+  double latency_max;
+};
+
+// output must come from CreateThreadedMIDIOutput, false if not threaded
+bool GetThreadedMIDIOutputStats(midi_Output* output, MIDIOutputStats* stats);
+
+// timestamp queued messages, enabling resets previous measurements
+void SetThreadedMIDIOutputLatencyMode(bool enable);
+
+// bytes_per_sec 0 = unlimited, sysex_gap in seconds, < 0 leaves unchanged
+void SetThreadedMIDIOutputPacing(midi_Output* output, double bytes_per_sec,
+                                 double sysex_gap);
+
+// queued note/CC/pitch bend/channel pressure are replaced by newer values
+// for the same status and controller instead of queuing behind, default on
+void SetThreadedMIDIOutputCoalescing(midi_Output* output, bool enable);
+
+// short message from one other thread than the one calling SendMsg(), sent
+// before other queued messages, not coalesced
+void SendThreadedMIDIOutputEcho(midi_Output* output, const MIDI_event_t* msg);
+
+// copies every message passed to SendMsg() into queue before pacing and
+// coalescing, echo lane is not captured. NULL stops. Queue is not owned.
+class MIDIInputQueue;
+void SetThreadedMIDIOutputCapture(midi_Output* output, MIDIInputQueue* queue);
+
+// hook runs in SendMsg() for every message, e.g. for tracing. NULL stops.
+typedef void (*MIDIOutputHook)(void* ctx, const MIDI_event_t* evt);
+void SetThreadedMIDIOutputHook(midi_Output* output, MIDIOutputHook hook,
+                               void* ctx);
+
+// Reads input on own thread. Hook runs on that thread for each message
+// before it is queued, e.g. for touch state or fader echo. Input is not
+// owned, destroy thread before input.
+class MIDIInputThread;
+typedef void (*MIDIInputHook)(void* ctx, const MIDI_event_t* evt);
+MIDIInputThread* CreateMIDIInputThread(midi_Input* input, MIDIInputHook hook,
+                                       void* ctx); // returns null on null
+void DestroyMIDIInputThread(MIDIInputThread* thread);
+
+// consumer side, main thread. time is time_precise() of message
+MIDI_event_t* GetMIDIInputThreadEvent(MIDIInputThread* thread, double* time);
+void PopMIDIInputThreadEvent(MIDIInputThread* thread);
+unsigned int GetMIDIInputThreadDropped(MIDIInputThread* thread);
+
 #define PREF_DIRCH WDL_DIRCHAR
 #define PREF_DIRSTR WDL_DIRCHAR_STR
 
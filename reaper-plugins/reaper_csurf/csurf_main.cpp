@@ -4,6 +4,8 @@
 ** License: LGPL.
 */
 
+#include <algorithm>
+#include <stddef.h>
 #include <string>
 
 #define REAPERAPI_IMPLEMENT
@@ -13,11 +15,18 @@
 
 #include "../localize-import.h"
 #include "csurf.h"
+#include "midi_input_queue.hpp"
+#include "midi_output_pacer.hpp"
+#include "spsc_queue.hpp"
 
 #include "../../WDL/win32_utf8.c"
 
 #include "../../WDL/setthreadname.h"
 
+#ifdef _WIN32
+#include <process.h>
+#endif
+
 namespace ReaMCULive
 {
 
@@ -114,10 +123,79 @@ extern "C"
 namespace ReaMCULive
 {
 
-#ifndef _WIN32 // let OS X use this threading step
+#define MIDIOUT_QUEUE_SIZE 128        // long messages (SysEx)
+#define MIDIOUT_SHORT_QUEUE_SIZE 2048 // 1-3 byte messages
+
+struct MIDIOutputSlot
+{
+  double time; // enqueue time_precise(), latency mode only
+  int epoch;   // latency mode epoch, 0 if not measured
+  unsigned int gen; // barrier generation, see IsBarrierSysEx
+  bool barrier;
+  MIDI_event_t evt; // midi_message continues into data
+  unsigned char data[MIDIOUT_SLOT_SIZE - sizeof(MIDI_event_t)];
+};
+static_assert(offsetof(MIDIOutputSlot, evt) +
+                  offsetof(MIDI_event_t, midi_message) + MIDIOUT_MAX_MESSAGE <=
+                sizeof(MIDIOutputSlot),
+              "MIDIOUT_MAX_MESSAGE does not fit slot");
+
+struct MIDIOutputShortSlot
+{
+  double time;
+  int epoch;
+  unsigned int gen; // barrier generation at enqueue, not set for echo
+  int key; // >= 0 send latest value of coalescing key instead of evt
+  MIDI_event_t evt;
+};
 
-#include "../../WDL/mutex.h"
-#include "../../WDL/ptrlist.h"
+// Short messages after a barrier SysEx are not sent before it, e.g. meter
+// overload clear after meter mode or fader positions after reset. LCD text
+// is no barrier, LED and fader updates can pass it.
+static bool IsBarrierSysEx(const MIDI_event_t* evt)
+{
+  const unsigned char* m = evt->midi_message;
+  return !(evt->size >= 6 && m[1] == 0x00 && m[2] == 0x00 && m[3] == 0x66 &&
+           m[5] == 0x12);
+}
+
+// Coalescing keys for messages where only the latest value matters:
+// 9n note (LEDs), Bn CC (V-Pot rings, time display), En pitch bend
+// (faders) and Dn channel pressure (MCU meters, track is high nibble).
+// Meter values 0xE/0xF set and clear overload, they are not levels and
+// always go out. Values are coalesced only within one barrier generation.
+#define MIDIOUT_COALESCE_KEYS (16 * 128 + 16 * 128 + 16 + 16 * 16)
+#define MIDIOUT_COALESCE_PENDING (1u << 31)
+#define MIDIOUT_COALESCE_GEN(gen) (((unsigned int)(gen)&0x7f) << 24)
+#define MIDIOUT_COALESCE_GEN_MASK MIDIOUT_COALESCE_GEN(0x7f)
+
+static int GetCoalesceKey(const unsigned char* msg)
+{
+  int ch = msg[0] & 0xf;
+  switch (msg[0] & 0xf0)
+  {
+  case 0x90:
+    return ch * 128 + (msg[1] & 0x7f);
+  case 0xb0:
+    return 16 * 128 + ch * 128 + (msg[1] & 0x7f);
+  case 0xe0:
+    return 2 * 16 * 128 + ch;
+  case 0xd0:
+    if ((msg[1] & 0xf) >= 0xe)
+      return -1;
+    return 2 * 16 * 128 + 16 + ch * 16 + ((msg[1] >> 4) & 0xf);
+  }
+  return -1;
+}
+
+// enqueue-to-wire latency measurement, each enable starts a new epoch
+static int g_latency_epoch;
+static int g_latency_epoch_next;
+
+void SetThreadedMIDIOutputLatencyMode(bool enable)
+{
+  g_latency_epoch = enable ? ++g_latency_epoch_next : 0;
+}
 
 class threadedMIDIOutput : public midi_Output
 {
@@ -126,6 +204,7 @@ public:
   {
     m_output = out;
     m_quit = 0;
+    m_event = CreateEvent(NULL, FALSE, FALSE, NULL);
     unsigned id;
     m_hThread = (HANDLE)_beginthreadex(NULL, 0, threadProc, this, 0, &id);
   }
@@ -135,6 +214,7 @@ public:
     if (m_hThread)
     {
       m_quit = 1;
+      SetEvent(m_event);
       WaitForSingleObject(m_hThread, INFINITE);
       CloseHandle(m_hThread);
       m_hThread = 0;
@@ -143,8 +223,8 @@ public:
 
     if (m_output)
       m_output->Destroy();
-    m_empty.Empty(true);
-    m_full.Empty(true);
+    if (m_event)
+      CloseHandle(m_event);
   }
 
   virtual void Destroy()
@@ -158,6 +238,7 @@ public:
     {
       m_hThread = NULL;
       m_quit = 2;
+      SetEvent(m_event);
 
       // thread will delete self
       WaitForSingleObject(thread, 100);
@@ -171,29 +252,117 @@ public:
   {
     if (!msg)
       return;
+    if (m_capture)
+      m_capture->Push(msg);
+    if (m_hook)
+      m_hook(m_hook_ctx, msg);
+    m_enqueued.fetch_add(1, std::memory_order_relaxed);
+    m_enqueued_bytes.fetch_add(msg->size, std::memory_order_relaxed);
+
+    int sz = msg->size;
+    if (sz < 3)
+      sz = 3;
+    int len = msg->midi_message + sz - (unsigned char*)msg;
+
+    double* time;
+    int* epoch;
+    if (msg->size <= 3)
+    {
+      int key = -1;
+      if (msg->size == 3 && m_cfg_coalesce.load(std::memory_order_relaxed))
+      {
+        key = GetCoalesceKey(msg->midi_message);
+      }
+      if (key >= 0)
+      {
+        unsigned int gen = MIDIOUT_COALESCE_GEN(m_barrier_gen);
+        unsigned int v = msg->midi_message[0] | msg->midi_message[1] << 8 |
+                         msg->midi_message[2] << 16 | gen;
+        // still queued, sender thread picks up the new value
+        unsigned int prev =
+          m_latest[key].exchange(v | MIDIOUT_COALESCE_PENDING);
+        if ((prev & MIDIOUT_COALESCE_PENDING) &&
+            (prev & MIDIOUT_COALESCE_GEN_MASK) == gen)
+        {
+          m_coalesced.fetch_add(1, std::memory_order_relaxed);
+          return;
+        }
+      }
 
-    WDL_HeapBuf* b = NULL;
-    if (m_empty.GetSize())
+      MIDIOutputShortSlot* slot = m_short.Alloc();
+      if (!slot)
+      {
+        if (key >= 0)
+          m_latest[key].fetch_and(~MIDIOUT_COALESCE_PENDING);
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      memcpy(&slot->evt, msg, len);
+      slot->gen = m_barrier_gen;
+      slot->key = key;
+      time = &slot->time;
+      epoch = &slot->epoch;
+    }
+    else
     {
-      m_mutex.Enter();
-      b = m_empty.Get(m_empty.GetSize() - 1);
-      m_empty.Delete(m_empty.GetSize() - 1);
-      m_mutex.Leave();
+      MIDIOutputSlot* slot =
+        msg->size <= MIDIOUT_MAX_MESSAGE ? m_queue.Alloc() : NULL;
+      if (!slot)
+      {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      memcpy(&slot->evt, msg, len);
+      slot->barrier = IsBarrierSysEx(msg);
+      if (slot->barrier)
+        m_barrier_gen++;
+      slot->gen = m_barrier_gen;
+      time = &slot->time;
+      epoch = &slot->epoch;
     }
-    if (!b && m_empty.GetSize() + m_full.GetSize() < 500)
-      b = new WDL_HeapBuf(256);
 
-    if (b)
+    *epoch = g_latency_epoch;
+    if (*epoch)
+      *time = time_precise();
+    if (msg->size <= 3)
+      m_short.Push();
+    else
+      m_queue.Push();
+
+    unsigned int queued = m_short.GetSize() + m_queue.GetSize();
+    if (queued > m_queued_max.load(std::memory_order_relaxed))
+      m_queued_max.store(queued, std::memory_order_relaxed);
+
+    Signal();
+  }
+
+  // second producer, e.g. input thread, short messages only
+  void SendEcho(const MIDI_event_t* msg)
+  {
+    MIDIOutputShortSlot* slot = msg->size <= 3 ? m_echo.Alloc() : NULL;
+    if (!slot)
     {
-      int sz = msg->size;
-      if (sz < 3)
-        sz = 3;
-      int len = msg->midi_message + sz - (unsigned char*)msg;
-      memcpy(b->Resize(len, false), msg, len);
-      m_mutex.Enter();
-      m_full.Add(b);
-      m_mutex.Leave();
+      m_dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
     }
+    slot->evt.frame_offset = 0;
+    slot->evt.size = msg->size;
+    memcpy(slot->evt.midi_message, msg->midi_message, 3);
+    slot->key = -1;
+    slot->epoch = g_latency_epoch;
+    if (slot->epoch)
+      slot->time = time_precise();
+    m_echo.Push();
+
+    Signal();
+  }
+
+  // only signal when sender thread is (about to be) waiting
+  void Signal()
+  {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_waiting.load(std::memory_order_relaxed))
+      SetEvent(m_event);
   }
 
   virtual void Send(
@@ -206,45 +375,173 @@ public:
 
   ///////////
 
+  // Short messages go before queued SysEx, echoed ones first, except that
+  // a barrier SysEx goes before shorts queued after it and other SysEx go
+  // once MIDIOUT_SYSEX_MAX_BYPASS shorts went ahead of them.
+  bool RunOnce(MIDIOutputPacer& pacer, double* waitUntil)
+  {
+    auto shortq = m_echo.Front() ? &m_echo : &m_short;
+    MIDIOutputShortSlot* shortslot = shortq->Front();
+    MIDIOutputSlot* slot = m_queue.Front();
+    if (shortslot && slot)
+    {
+      int d = (int)(shortslot->gen - slot->gen);
+      if ((!slot->barrier && m_bypassed >= MIDIOUT_SYSEX_MAX_BYPASS) ||
+          (shortq == &m_short && (d > 0 || (d == 0 && slot->barrier))))
+        shortslot = NULL;
+      else
+        slot = NULL;
+    }
+    if (!shortslot && !slot)
+      return false;
+
+    MIDI_event_t* evt = shortslot ? &shortslot->evt : &slot->evt;
+    bool sysex = !shortslot;
+    int len = evt->size;
+
+    double now = time_precise();
+    double t = pacer.GetSendTime(len, sysex, now);
+    if (t > now)
+    {
+      *waitUntil = t;
+      return false;
+    }
+
+    if (shortslot && shortslot->key >= 0)
+    {
+      // latest value of same barrier generation, if a barrier came between
+      // this slot sends its own and a newer slot the latest
+      auto& latest = m_latest[shortslot->key];
+      unsigned int gen = MIDIOUT_COALESCE_GEN(shortslot->gen);
+      unsigned int v = latest.load();
+      while ((v & MIDIOUT_COALESCE_GEN_MASK) == gen &&
+             !latest.compare_exchange_weak(v, v & ~MIDIOUT_COALESCE_PENDING))
+      {
+      }
+      if ((v & MIDIOUT_COALESCE_GEN_MASK) == gen)
+      {
+        evt->midi_message[0] = v & 0xff;
+        evt->midi_message[1] = (v >> 8) & 0xff;
+        evt->midi_message[2] = (v >> 16) & 0xff;
+      }
+    }
+
+    if (m_output)
+      m_output->SendMsg(evt, -1);
+    pacer.OnSend(len, sysex, now);
+
+    int epoch = shortslot ? shortslot->epoch : slot->epoch;
+    if (epoch)
+    {
+      AddLatency(epoch,
+                 time_precise() - (shortslot ? shortslot->time : slot->time));
+    }
+    if (shortslot)
+    {
+      shortq->Pop();
+      if (m_queue.Front())
+        m_bypassed++;
+    }
+    else
+    {
+      m_queue.Pop();
+      m_bypassed = 0;
+    }
+
+    m_sent.fetch_add(1, std::memory_order_relaxed);
+    m_bytes.fetch_add(len, std::memory_order_relaxed);
+    return true;
+  }
+
   static unsigned WINAPI threadProc(LPVOID p)
   {
     WDL_SetThreadName("reaper/cs_midio");
-    WDL_HeapBuf* lastbuf = NULL;
     threadedMIDIOutput* _this = (threadedMIDIOutput*)p;
-    unsigned int scnt = 0;
+    MIDIOutputPacer pacer;
     for (;;)
     {
-      if (_this->m_full.GetSize() || lastbuf)
+      pacer.SetRate(_this->m_cfg_rate.load(std::memory_order_relaxed));
+      pacer.SetSysExGap(_this->m_cfg_gap.load(std::memory_order_relaxed));
+
+      double waitUntil = 0.0;
+      if (_this->RunOnce(pacer, &waitUntil))
+        continue;
+
+      if (!waitUntil && _this->m_quit)
+        break; // only quit once all messages have been sent
+
+      // wake on new messages, short ones may go before paced SysEx
+      _this->m_waiting.store(true, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (waitUntil)
       {
-        _this->m_mutex.Enter();
-        if (lastbuf)
-          _this->m_empty.Add(lastbuf);
-        lastbuf = _this->m_full.Get(0);
-        _this->m_full.Delete(0);
-        _this->m_mutex.Leave();
-
-        if (lastbuf)
-          _this->m_output->SendMsg((MIDI_event_t*)lastbuf->Get(), -1);
-        scnt = 0;
+        int ms = (int)((waitUntil - time_precise()) * 1000.0) + 1;
+        WaitForSingleObject(_this->m_event, ms > 0 ? ms : 0);
       }
-      else
+      else if (!_this->m_short.Front() && !_this->m_queue.Front() &&
+               !_this->m_echo.Front() && !_this->m_quit)
       {
-        Sleep(1);
-        if (_this->m_quit && scnt++ > 3)
-          break; // only quit once all messages have been sent
+        WaitForSingleObject(_this->m_event, INFINITE);
       }
+      _this->m_waiting.store(false, std::memory_order_relaxed);
     }
-    delete lastbuf;
     if (_this->m_quit == 2)
       delete _this;
     return 0;
   }
 
-  WDL_Mutex m_mutex;
-  WDL_PtrList<WDL_HeapBuf> m_full, m_empty;
+  // sender thread only writes these
+  void AddLatency(int epoch, double latency)
+  {
+    if (epoch != m_latency_epoch)
+    {
+      m_latency_epoch = epoch;
+      m_latency_sum.store(0.0, std::memory_order_relaxed);
+      m_latency_max.store(0.0, std::memory_order_relaxed);
+      m_latency_cnt.store(0, std::memory_order_relaxed);
+    }
+    m_latency_sum.store(m_latency_sum.load(std::memory_order_relaxed) + latency,
+                        std::memory_order_relaxed);
+    if (latency > m_latency_max.load(std::memory_order_relaxed))
+      m_latency_max.store(latency, std::memory_order_relaxed);
+    m_latency_cnt.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  SPSCQueue<MIDIOutputShortSlot, MIDIOUT_SHORT_QUEUE_SIZE> m_short;
+  SPSCQueue<MIDIOutputShortSlot, MIDIOUT_SHORT_QUEUE_SIZE> m_echo;
+  SPSCQueue<MIDIOutputSlot, MIDIOUT_QUEUE_SIZE> m_queue;
+  std::atomic<unsigned int> m_sent{0};
+  std::atomic<unsigned int> m_bytes{0};
+  std::atomic<unsigned int> m_enqueued{0};
+  std::atomic<unsigned int> m_enqueued_bytes{0};
+  std::atomic<unsigned int> m_queued_max{0}; // written by SendMsg() only
+  std::atomic<unsigned int> m_dropped{0}; // queue full or oversized
+  std::atomic<unsigned int> m_coalesced{0}; // superseded before sent
+
+  // latest value per coalescing key with MIDIOUT_COALESCE_GEN of its
+  // barrier generation, MIDIOUT_COALESCE_PENDING if queued
+  std::atomic<unsigned int> m_latest[MIDIOUT_COALESCE_KEYS]{};
+
+  std::atomic<double> m_cfg_rate{0.0}; // bytes/second, 0 = unlimited
+  std::atomic<double> m_cfg_gap{MIDIOUT_SYSEX_GAP};
+  std::atomic<bool> m_cfg_coalesce{true};
+
+  unsigned int m_barrier_gen{0}; // SendMsg() only, barrier SysEx queued
+  int m_bypassed{0}; // sender thread only, shorts sent ahead of SysEx
+
+  MIDIInputQueue* m_capture{}; // SendMsg() thread only
+  MIDIOutputHook m_hook{};
+  void* m_hook_ctx{};
+
+  int m_latency_epoch{0};
+  std::atomic<double> m_latency_sum{0.0};
+  std::atomic<double> m_latency_max{0.0};
+  std::atomic<unsigned int> m_latency_cnt{0};
 
   HANDLE m_hThread;
-  int m_quit; // set to 1 to finish, 2 to finish+delete self
+  HANDLE m_event;                   // signaled when queue gets work or on quit
+  std::atomic<bool> m_waiting{false}; // sender thread waits for m_event
+  std::atomic<int> m_quit; // set to 1 to finish, 2 to finish+delete self
   midi_Output* m_output;
 };
 
@@ -255,13 +552,203 @@ midi_Output* CreateThreadedMIDIOutput(midi_Output* output)
   return new threadedMIDIOutput(output);
 }
 
-#else
+midi_Output* CreateVirtualMIDIOutput()
+{
+  return new threadedMIDIOutput(NULL);
+}
 
-// windows doesnt need it since we have threaded midi outputs now
-midi_Output* CreateThreadedMIDIOutput(midi_Output* output)
+void SetThreadedMIDIOutputCapture(midi_Output* output, MIDIInputQueue* queue)
+{
+  if (!output)
+    return;
+  threadedMIDIOutput* out = static_cast<threadedMIDIOutput*>(output);
+  out->m_capture = queue;
+}
+
+void SetThreadedMIDIOutputHook(midi_Output* output, MIDIOutputHook hook,
+                               void* ctx)
 {
-  return output;
+  if (!output)
+    return;
+  threadedMIDIOutput* out = static_cast<threadedMIDIOutput*>(output);
+  out->m_hook_ctx = ctx;
+  out->m_hook = hook;
 }
 
-#endif
-} // namespace ReaMCULive
\ No newline at end of file
+bool GetThreadedMIDIOutputStats(midi_Output* output, MIDIOutputStats* stats)
+{
+  if (!output || !stats)
+    return false;
+  threadedMIDIOutput* out = static_cast<threadedMIDIOutput*>(output);
+  stats->sent = out->m_sent.load(std::memory_order_relaxed);
+  stats->bytes = out->m_bytes.load(std::memory_order_relaxed);
+  stats->enqueued = out->m_enqueued.load(std::memory_order_relaxed);
+  stats->enqueued_bytes = out->m_enqueued_bytes.load(std::memory_order_relaxed);
+  stats->queued_max = out->m_queued_max.load(std::memory_order_relaxed);
+  stats->dropped = out->m_dropped.load(std::memory_order_relaxed);
+  stats->coalesced = out->m_coalesced.load(std::memory_order_relaxed);
+  stats->queued =
+    out->m_short.GetSize() + out->m_echo.GetSize() + out->m_queue.GetSize();
+  stats->latency_cnt = out->m_latency_cnt.load(std::memory_order_relaxed);
+  stats->latency_avg =
+    stats->latency_cnt
+      ? out->m_latency_sum.load(std::memory_order_relaxed) / stats->latency_cnt
+      : 0.0;
+  stats->latency_max = out->m_latency_max.load(std::memory_order_relaxed);
+  return true;
+}
+
+void SetThreadedMIDIOutputPacing(midi_Output* output, double bytes_per_sec,
+                                 double sysex_gap)
+{
+  if (!output)
+    return;
+  threadedMIDIOutput* out = static_cast<threadedMIDIOutput*>(output);
+  if (bytes_per_sec >= 0.0)
+    out->m_cfg_rate.store(bytes_per_sec, std::memory_order_relaxed);
+  if (sysex_gap >= 0.0)
+    out->m_cfg_gap.store(sysex_gap, std::memory_order_relaxed);
+  SetEvent(out->m_event);
+}
+
+void SetThreadedMIDIOutputCoalescing(midi_Output* output, bool enable)
+{
+  if (!output)
+    return;
+  threadedMIDIOutput* out = static_cast<threadedMIDIOutput*>(output);
+  out->m_cfg_coalesce.store(enable, std::memory_order_relaxed);
+}
+
+void SendThreadedMIDIOutputEcho(midi_Output* output, const MIDI_event_t* msg)
+{
+  if (!output || !msg)
+    return;
+  threadedMIDIOutput* out = static_cast<threadedMIDIOutput*>(output);
+  out->SendEcho(msg);
+}
+
+#define MIDIIN_THREAD_QUEUE_SIZE 1024
+#define MIDIIN_THREAD_INTERVAL 1 // ms between input reads
+
+struct MIDIInputSlot
+{
+  double time;      // time_precise() of message
+  MIDI_event_t evt; // midi_message continues into data
+  unsigned char data[MIDIOUT_SLOT_SIZE - sizeof(MIDI_event_t)];
+};
+
+// Reads midi_Input continuously, hands messages to main thread through
+// SPSC queue. Does not own input.
+class MIDIInputThread
+{
+public:
+  MIDIInputThread(midi_Input* input, MIDIInputHook hook, void* ctx)
+  {
+    m_input = input;
+    m_hook = hook;
+    m_ctx = ctx;
+    m_lastswap = time_precise();
+    m_input->SwapBufsPrecise(0, m_lastswap); // drop stale input
+    unsigned id;
+    m_hThread = (HANDLE)_beginthreadex(NULL, 0, threadProc, this, 0, &id);
+  }
+
+  ~MIDIInputThread()
+  {
+    if (m_hThread)
+    {
+      m_quit = true;
+      WaitForSingleObject(m_hThread, INFINITE);
+      CloseHandle(m_hThread);
+    }
+  }
+
+  void RunOnce()
+  {
+    double now = time_precise();
+    m_input->SwapBufsPrecise(0, now);
+    MIDI_eventlist* list = m_input->GetReadBuf();
+    MIDI_event_t* evt;
+    int l = 0;
+    while ((evt = list->EnumItems(&l)))
+    {
+      // frame_offset is 1/1024000 s into read period
+      double t = m_lastswap + evt->frame_offset / 1024000.0;
+      if (t > now)
+        t = now;
+
+      if (m_hook)
+        m_hook(m_ctx, evt);
+
+      int len = evt->midi_message + std::max(evt->size, 3) - (unsigned char*)evt;
+      MIDIInputSlot* slot =
+        len <= (int)sizeof(MIDIInputSlot) - (int)offsetof(MIDIInputSlot, evt)
+          ? m_queue.Alloc()
+          : NULL;
+      if (!slot)
+      {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        continue;
+      }
+      slot->time = t;
+      memcpy(&slot->evt, evt, len);
+      m_queue.Push();
+    }
+    m_lastswap = now;
+  }
+
+  static unsigned WINAPI threadProc(LPVOID p)
+  {
+    WDL_SetThreadName("reaper/cs_midii");
+    MIDIInputThread* _this = (MIDIInputThread*)p;
+    while (!_this->m_quit)
+    {
+      _this->RunOnce();
+      Sleep(MIDIIN_THREAD_INTERVAL);
+    }
+    return 0;
+  }
+
+  SPSCQueue<MIDIInputSlot, MIDIIN_THREAD_QUEUE_SIZE> m_queue;
+  std::atomic<unsigned int> m_dropped{0}; // queue full or oversized
+  std::atomic<bool> m_quit{false};
+  HANDLE m_hThread;
+  midi_Input* m_input;
+  MIDIInputHook m_hook;
+  void* m_ctx;
+  double m_lastswap; // input thread only
+};
+
+MIDIInputThread* CreateMIDIInputThread(midi_Input* input, MIDIInputHook hook,
+                                       void* ctx)
+{
+  if (!input)
+    return NULL;
+  return new MIDIInputThread(input, hook, ctx);
+}
+
+void DestroyMIDIInputThread(MIDIInputThread* thread)
+{
+  delete thread;
+}
+
+MIDI_event_t* GetMIDIInputThreadEvent(MIDIInputThread* thread, double* time)
+{
+  MIDIInputSlot* slot = thread->m_queue.Front();
+  if (!slot)
+    return NULL;
+  *time = slot->time;
+  return &slot->evt;
+}
+
+void PopMIDIInputThreadEvent(MIDIInputThread* thread)
+{
+  thread->m_queue.Pop();
+}
+
+unsigned int GetMIDIInputThreadDropped(MIDIInputThread* thread)
+{
+  return thread->m_dropped.load(std::memory_order_relaxed);
+}
+
+} // namespace ReaMCULive
@@ -7,14 +7,21 @@
 #include "reascript_vararg.hpp"
 
 #include <algorithm>
+#include <atomic>
 #include <mutex>
 #include <queue>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "reaper_plugin_functions.h"
 
+#include "button_routes.hpp"
 #include "csurf.h"
+#include "midi_input_queue.hpp"
+#include "surface_trace.hpp"
+#include "track_index.hpp"
+#include "volume_tables.hpp"
 
 // #define timeGetTime() GetTickCount64()
 
@@ -26,32 +33,76 @@
 namespace ReaMCULive
 {
 
-static MediaTrack* GetOutputTrack()
+// GUID index of current project tracks, rebuilt on first lookup after
+// track list change or project switch
+static TrackGUIDIndex<MediaTrack> g_track_index;
+
+// bumped on track list change to drop cached output track
+static int g_output_track_gen{0};
+
+static void InvalidateOutputTrack()
 {
-  static MediaTrack* res{nullptr};
-  if (res != nullptr && ValidatePtr2(0, res, "MediaTrack*"))
+  g_output_track_gen++;
+}
+
+static void InvalidateTrackIndex()
+{
+  g_track_index.Invalidate();
+}
+
+MediaTrack* TrackFromGUID(const GUID& guid)
+{
+  auto proj = EnumProjects(-1, NULL, 0);
+  if (!g_track_index.IsValid(proj))
   {
-    return res;
+    g_track_index.Clear();
+    for (auto i = 0; i < GetNumTracks(); i++)
+    {
+      auto tr = GetTrack(0, i);
+      const GUID* tguid = GetTrackGUID(tr);
+      if (tr && tguid)
+        g_track_index.Add(*tguid, tr);
+    }
+    g_track_index.SetValid(proj);
   }
-  else
+  return g_track_index.Find(guid);
+}
+
+static bool IsOutputTrackName(const char* name)
+{
+  char buf[BUFSIZ]{};
+  for (size_t i = 0; name[i] != '\0' && i < BUFSIZ - 1; i++)
+  {
+    buf[i] = tolower(name[i]);
+  }
+  return strstr(buf, "mcu") && strstr(buf, "live");
+}
+
+// Called per track per refresh, so result (also not found) is cached until
+// track list change or project switch.
+static MediaTrack* GetOutputTrack()
+{
+  static MediaTrack* res{nullptr};
+  static ReaProject* proj{nullptr};
+  static int gen{-1};
+
+  auto cur = EnumProjects(-1, NULL, 0);
+  if (gen == g_output_track_gen && proj == cur)
   {
-    res = nullptr;
+    return res != nullptr ? res : GetMasterTrack(0);
   }
+  gen = g_output_track_gen;
+  proj = cur;
+  res = nullptr;
 
   char buf[BUFSIZ]{};
   char gbuf[BUFSIZ]{};
   GUID* g{};
-  GetProjExtState(0, "ak5k", "mculiveout", buf, BUFSIZ);
-
-  for (int i = 0; i < GetNumTracks(); i++)
+  if (GetProjExtState(0, "ak5k", "mculiveout", buf, BUFSIZ) > 0 && buf[0])
   {
-    auto tr = GetTrack(0, i);
-    g = GetTrackGUID(tr);
-    guidToString(g, gbuf);
-    if (strcmp(buf, gbuf) == 0)
-    {
-      res = tr;
-    }
+    GUID stored{};
+    stringToGuid(buf, &stored);
+    res = TrackFromGUID(stored);
   }
 
   if (res == nullptr)
@@ -59,12 +110,8 @@ static MediaTrack* GetOutputTrack()
     for (int i = 0; i < GetNumTracks(); i++)
     {
       auto tr = GetTrack(0, i);
-      GetTrackName(tr, buf, BUFSIZ);
-      for (size_t i = 0; buf[i] != '\0'; i++)
-      {
-        buf[i] = tolower(buf[i]);
-      }
-      if (strstr(buf, "mcu") && strstr(buf, "live"))
+      GetTrackName(tr, gbuf, BUFSIZ);
+      if (IsOutputTrackName(gbuf))
       {
         res = tr;
         break;
@@ -75,8 +122,11 @@ static MediaTrack* GetOutputTrack()
   if (res != nullptr)
   {
     g = GetTrackGUID(res);
-    guidToString(g, buf);
-    SetProjExtState(0, "ak5k", "mculiveout", buf);
+    guidToString(g, gbuf);
+    if (strcmp(buf, gbuf) != 0)
+    {
+      SetProjExtState(0, "ak5k", "mculiveout", gbuf);
+    }
     return res;
   }
 
@@ -95,31 +145,12 @@ static MediaTrack* GetTrackFromID(int idx, bool mcpView)
 
 #define CSurf_TrackFromID GetTrackFromID
 
-static double int14ToVol(unsigned char msb, unsigned char lsb)
-{
-  int val = lsb | (msb << 7);
-  double pos = ((double)val * 1000.0) / 16383.0;
-  pos = SLIDER2DB(pos);
-  return DB2VAL(pos);
-}
-
 static double int14ToPan(unsigned char msb, unsigned char lsb)
 {
   int val = lsb | (msb << 7);
   return 1.0 - (val / (16383.0 * 0.5));
 }
 
-static int volToInt14(double vol)
-{
-  double d = (DB2SLIDER(VAL2DB(vol)) * 16383.0 / 1000.0);
-  if (d < 0.0)
-    d = 0.0;
-  else if (d > 16383.0)
-    d = 16383.0;
-
-  return (int)(d + 0.5);
-}
-
 static int panToInt14(double pan)
 {
   double d = ((1.0 - pan) * 16383.0 * 0.5);
@@ -131,17 +162,6 @@ static int panToInt14(double pan)
   return (int)(d + 0.5);
 }
 
-static unsigned char volToChar(double vol)
-{
-  double d = (DB2SLIDER(VAL2DB(vol)) * 127.0 / 1000.0);
-  if (d < 0.0)
-    d = 0.0;
-  else if (d > 127.0)
-    d = 127.0;
-
-  return (unsigned char)(d + 0.5);
-}
-
 static unsigned char panToChar(double pan)
 {
   pan = (pan + 1.0) * 63.5;
@@ -187,27 +207,213 @@ typedef void (CSurf_MCULive::*ScheduleFunc)();
 
 #define CONFIG_FLAG_FADER_TOUCH_MODE 1
 
+// Per device model of button LEDs (90 nn vv), V-Pot rings and time display
+// (b0 cc vv) and faders (en ll mm), all on channel 0 except faders.
+// SURFACE_UNKNOWN means never set or not known what the device shows.
+#define SURFACE_UNKNOWN -1
+struct SurfaceState
+{
+  int note[128];
+  int cc[128];
+  int pitch[16];
+};
+
+#define LCD_SIZE (56 * 2)
+#define LCD_SYSEX_OVERHEAD 8 // f0 00 00 66 14 12 pos .. f7
+
 #define DOUBLE_CLICK_INTERVAL 0.250 /* ms */
 
-MediaTrack* TrackFromGUID(const GUID& guid)
+#define VU_BOTTOM 70      // dB
+#define VU_SEGMENTS 13    // 0xd, 0xe turns on clip indicator, 0xf turns it off
+#define VU_FALLOFF 1.4    // s from 0 dB to VU_BOTTOM, they claim 1.8s for
+                          // falloff but we'll underestimate
+#define VU_REFRESH 0.25   // s, resend unchanged segment so device keeps it lit
+#define VU_HOLD_MIN 1e-7  // -140 dB, peak hold stops falling here
+
+// linear peak where meter segment v begins, see InitMeterThresholds
+static double g_vu_threshold[VU_SEGMENTS + 1];
+
+static void InitMeterThresholds()
+{
+  for (int v = 0; v <= VU_SEGMENTS; v++)
+    g_vu_threshold[v] = DB2VAL(-VU_BOTTOM + v * (double)VU_BOTTOM / VU_SEGMENTS);
+}
+
+// Per device hot path timing, see MCULive_GetStats
+#define STATS_BUCKETS 8
+
+enum
+{
+  STAT_RUN,         // whole Run(), includes stages below
+  STAT_RUN_OUTPUT,  // time display, transport LEDs
+  STAT_RUN_METERS,  // VU meters
+  STAT_INPUT,       // one input message
+  STAT_SET_SURFACE, // one SetSurface* callback from REAPER
+  STAT_STAGES
+};
+
+static const char* g_stat_names[STAT_STAGES] = {
+  "run", "run_output", "run_meters", "input", "set_surface"};
+
+// upper bounds of histogram buckets in seconds, last bucket is open
+static const double g_stat_bounds[STATS_BUCKETS - 1] = {
+  10e-6, 30e-6, 100e-6, 300e-6, 1e-3, 3e-3, 10e-3};
+
+struct StageStats
 {
-  // for (TrackIterator ti; !ti.end(); ++ti) {
-  for (auto i = 0; i < GetNumTracks(); i++)
+  unsigned int count;
+  double total;
+  double max;
+  unsigned int hist[STATS_BUCKETS];
+
+  void Add(double t)
   {
-    auto tr = GetTrack(0, i);
-    const GUID* tguid = GetTrackGUID(tr);
+    count++;
+    total += t;
+    if (t > max)
+      max = t;
+    int b = 0;
+    while (b < STATS_BUCKETS - 1 && t >= g_stat_bounds[b])
+      b++;
+    hist[b]++;
+  }
+};
+
+struct DeviceStats
+{
+  StageStats stage[STAT_STAGES];
+  unsigned int events_in;
+  int input_queue_max; // high-water mark of script input queue
+};
 
-    if (tr && tguid && !memcmp(tguid, &guid, sizeof(GUID)))
-      return tr;
+// times enclosing scope into stage
+class StatTimer
+{
+public:
+  StatTimer(DeviceStats& stats, int stage)
+    : m_stage(&stats.stage[stage]), m_start(time_precise())
+  {
+  }
+  ~StatTimer()
+  {
+    m_stage->Add(time_precise() - m_start);
+  }
+
+  double GetStart() const
+  {
+    return m_start;
+  }
+
+private:
+  StageStats* m_stage;
+  double m_start;
+};
+
+static double g_stats_dump_interval{0}; // s, see MCULive_SetOption
+static double g_stats_dump_lastrun{0};
+
+static int GetMeterSegment(double peak)
+{
+  int v = 0;
+  while (v < VU_SEGMENTS && peak >= g_vu_threshold[v + 1])
+    v++;
+  return v;
+}
+
+// peak hold factor after falling for dt seconds
+static double GetMeterDecay(double dt)
+{
+  return DB2VAL(-VU_BOTTOM * dt / VU_FALLOFF);
+}
+
+// Sends on faders mode: selected track and send index from each track to
+// it, shared by all surfaces. Selected track is refetched after selection
+// change, index is dropped on track list change. Entries are checked
+// against destination and send count before use, and rescanned on mismatch.
+// Only found sends are kept, a send may be retargeted to dst without send
+// count changing so misses are always rescanned.
+struct SendIndexEntry
+{
+  MediaTrack* dst;
+  int idx;
+  int nsends;
+};
+static std::unordered_map<MediaTrack*, SendIndexEntry> g_send_index;
+static MediaTrack* g_selected_track{nullptr};
+static bool g_selected_track_valid{false};
+
+static void InvalidateSendIndex()
+{
+  g_send_index.clear();
+  g_selected_track_valid = false;
+}
+
+static void OnSelectedTrackChange(MediaTrack* tr, bool selected)
+{
+  if (selected ? tr != g_selected_track : tr == g_selected_track)
+  {
+    g_selected_track_valid = false;
+  }
+}
+
+static MediaTrack* GetSelectedTrackCached()
+{
+  if (!g_selected_track_valid)
+  {
+    g_selected_track = GetSelectedTrack(0, 0);
+    g_selected_track_valid = true;
   }
-  return NULL;
+  return g_selected_track;
+}
+
+// One refresh: per track values each surface needs in SetSurface* callbacks,
+// looked up by first surface asking and shared by the rest. Dropped every
+// update cycle (first device's Run()), on track list change and after own
+// send changes.
+enum
+{
+  REFRESH_SEND_VOL = 1,
+  REFRESH_SEND_PAN = 2,
+  REFRESH_SEND_MUTE = 4,
+  REFRESH_SEND_IDX = 8,
+};
+struct RefreshCacheEntry
+{
+  unsigned int gen;
+  int id; // CSurf_TrackToID()
+  MediaTrack* send_dst;
+  int send_idx;
+  int send_have; // REFRESH_SEND_* fetched for send_dst
+  double send_vol;
+  double send_pan;
+  bool send_mute;
+};
+static std::unordered_map<MediaTrack*, RefreshCacheEntry> g_refresh_cache;
+static unsigned int g_refresh_gen{1};
+
+static void InvalidateRefreshCache()
+{
+  g_refresh_gen++;
+}
+
+static RefreshCacheEntry* GetRefreshCache(MediaTrack* tr)
+{
+  auto& e = g_refresh_cache[tr];
+  if (e.gen != g_refresh_gen)
+  {
+    e.gen = g_refresh_gen;
+    e.id = CSurf_TrackToID(tr, g_csurf_mcpmode);
+    e.send_dst = NULL;
+    e.send_have = 0;
+  }
+  return &e;
 }
 
 class CSurf_MCULive : public IReaperControlSurface
 {
 public:
   bool m_is_mcuex;
-  bool m_is_default{true};
+  std::atomic<bool> m_is_default{true}; // also read by input thread
   int m_midi_in_dev;
   int m_midi_out_dev;
   int m_offset;
@@ -217,12 +423,12 @@ public:
   midi_Output* m_midiout;
   midi_Input* m_midiin;
 
-  int m_vol_lastpos[BUFSIZ];
-  int m_pan_lastpos[BUFSIZ];
-  char m_mackie_lasttime[10];
+  SurfaceState m_state; // requested by surface logic and API
+  SurfaceState m_shown; // last sent to device
+  char m_lcd[LCD_SIZE]; // what LCD shows, 0 if unknown
   int m_mackie_lasttime_mode;
   int m_mackie_modifiers;
-  int m_cfg_flags;      // CONFIG_FLAG_FADER_TOUCH_MODE etc
+  std::atomic<int> m_cfg_flags; // CONFIG_FLAG_FADER_TOUCH_MODE etc
   int m_last_miscstate; // &1=metronome
 
   int m_fader_pos[BUFSIZ]{};
@@ -234,7 +440,27 @@ public:
   int m_button_states[BUFSIZ]{};
   int m_button_remap[BUFSIZ]{};
 
-  std::vector<MIDI_event_t> midiBuffer{};
+  MIDIInputQueue midiBuffer; // for scripts
+  DeviceStats m_stats{};
+  SurfaceTrace m_trace; // always on, see MCULive_DumpTrace
+  std::vector<TraceRecord> m_replay; // input from MCULive_ReplayTrace
+  size_t m_replay_pos{};
+  double m_replay_start{};
+  MIDIInputQueue m_inject;   // from scripts, handled as device input
+  MIDIInputQueue m_capture;  // output copy for scripts, see SetCapture
+  bool m_capture_enabled{false};
+  bool m_virtual_out{false}; // m_midiout has no device
+
+  // input coalescing, fader and V-Pot messages held until end of Run() or
+  // next other message
+  bool m_input_coalesce{false};
+  int m_pending_faders{}; // bit per fader
+  MIDI_event_t m_pending_fader[16]{};
+  int m_pending_encoder[8]{}; // summed delta
+  int m_pending_encoder_frame{};
+
+  MIDIInputThread* m_input_thread{}; // optional, reads m_midiin
+  double m_input_lastrun{};
 
   int m_page{};
   int m_mode{};            // mode assignment
@@ -242,7 +468,7 @@ public:
   int m_flipflags{1 << 0}; // allow flipmode flags
   int m_is_split;
 
-  char m_fader_touchstate[BUFSIZ];
+  std::atomic<char> m_fader_touchstate[BUFSIZ]{}; // input thread writes too
   double m_fader_lasttouch[BUFSIZ]; // m_fader_touchstate changes will
                                     // clear this, moves otherwise set it.
                                     // if set to -1, then totally disabled
@@ -251,7 +477,13 @@ public:
   WDL_String m_descspace;
   char m_configtmp[4 * BUFSIZ];
 
-  double m_mcu_meterpos[8];
+  double m_mcu_meterpos[8]; // linear peak hold, falls VU_FALLOFF
+  MediaTrack* m_strip_track[8]{}; // track shown on strip, see UpdateStrip
+  int m_strip_valid{};            // bit per strip, m_strip_track known
+  int m_mcu_meter_sent[8];    // last segment sent, -1 if none
+  double m_mcu_meter_senttime[8];
+  double m_mcu_meter_falltime[8]; // m_mcu_meterpos fallen until, 0 if never
+  int m_meter_rate{0}; // Hz, 0 = csurfrate
   double m_mcu_timedisp_lastforce{0};
   double m_mcu_meter_lastrun{0};
   int m_mackie_arrow_states;
@@ -275,12 +507,127 @@ public:
            (this->m_is_split ? g_split_bank_offset : g_allmcus_bank_offset);
   }
 
+  // All surface output of LEDs, rings, time display and faders goes through
+  // here. Value is stored as requested state and sent only if device is not
+  // known to show it already.
+  void SetSurfaceState(unsigned char status, unsigned char d1, int value)
+  {
+    int* want;
+    int* shown;
+    switch (status & 0xf0)
+    {
+    case 0x90:
+      want = &m_state.note[d1 & 0x7f];
+      shown = &m_shown.note[d1 & 0x7f];
+      break;
+    case 0xb0:
+      want = &m_state.cc[d1 & 0x7f];
+      shown = &m_shown.cc[d1 & 0x7f];
+      break;
+    case 0xe0:
+      want = &m_state.pitch[status & 0xf];
+      shown = &m_shown.pitch[status & 0xf];
+      break;
+    default:
+      return;
+    }
+    *want = value;
+    if (*shown != value && m_midiout)
+    {
+      *shown = value;
+      SendSurfaceState(status, d1, value);
+    }
+  }
+
+  void SendSurfaceState(unsigned char status, unsigned char d1, int value)
+  {
+    if ((status & 0xf0) == 0xe0)
+      m_midiout->Send(status, value & 0x7f, (value >> 7) & 0x7f, -1);
+    else
+      m_midiout->Send(status, d1, (unsigned char)value, -1);
+  }
+
+  void SetNote(int note, int value)
+  {
+    SetSurfaceState(0x90, (unsigned char)note, value);
+  }
+
+  void SetCC(int cc, int value)
+  {
+    SetSurfaceState(0xb0, (unsigned char)cc, value);
+  }
+
+  void SetFader(int idx, int value)
+  {
+    SetSurfaceState(0xe0 + (idx & 0xf), 0, value);
+  }
+
+  // forget what device shows, next write of the range is always sent
+  void InvalidateSurfaceState(unsigned char status, int first, int last)
+  {
+    int* shown;
+    int n;
+    switch (status & 0xf0)
+    {
+    case 0x90:
+      shown = m_shown.note;
+      n = 128;
+      break;
+    case 0xb0:
+      shown = m_shown.cc;
+      n = 128;
+      break;
+    case 0xe0:
+      shown = m_shown.pitch;
+      n = 16;
+      break;
+    default:
+      return;
+    }
+    for (int i = std::max(first, 0); i <= last && i < n; i++)
+      shown[i] = SURFACE_UNKNOWN;
+  }
+
+  // Sends requested state that differs from what device shows. force
+  // assumes device shows nothing known, e.g. after it was reset.
+  void FlushSurfaceState(bool force)
+  {
+    if (force)
+      memset(&m_shown, 0xff, sizeof(m_shown));
+    if (!m_midiout)
+      return;
+
+    for (int i = 0; i < 128; i++)
+    {
+      if (m_state.note[i] != SURFACE_UNKNOWN && m_state.note[i] != m_shown.note[i])
+      {
+        m_shown.note[i] = m_state.note[i];
+        SendSurfaceState(0x90, i, m_state.note[i]);
+      }
+      if (m_state.cc[i] != SURFACE_UNKNOWN && m_state.cc[i] != m_shown.cc[i])
+      {
+        m_shown.cc[i] = m_state.cc[i];
+        SendSurfaceState(0xb0, i, m_state.cc[i]);
+      }
+    }
+    for (int i = 0; i < 16; i++)
+    {
+      if (m_state.pitch[i] != SURFACE_UNKNOWN &&
+          m_state.pitch[i] != m_shown.pitch[i])
+      {
+        m_shown.pitch[i] = m_state.pitch[i];
+        SendSurfaceState(0xe0 + i, 0, m_state.pitch[i]);
+      }
+    }
+  }
+
   void MCUReset()
   {
     std::sort(g_mcu_list.begin(), g_mcu_list.end(), CompareMCULiveOffset);
 
-    memset(m_mackie_lasttime, 0, sizeof(m_mackie_lasttime));
-    memset(m_fader_touchstate, 0, sizeof(m_fader_touchstate));
+    memset(m_lcd, 0, sizeof(m_lcd));
+    for (auto& t : m_fader_touchstate)
+      t.store(0, std::memory_order_relaxed);
     memset(m_fader_lasttouch, 0, sizeof(m_fader_lasttouch));
     memset(m_pan_lasttouch, 0, sizeof(m_pan_lasttouch));
     m_mackie_lasttime_mode = -1;
@@ -289,25 +636,21 @@ public:
     m_buttonstate_lastrun = 0;
     m_mackie_arrow_states = 0;
 
-    memset(m_vol_lastpos, 0xff, sizeof(m_vol_lastpos));
-    memset(m_pan_lastpos, 0xff, sizeof(m_pan_lastpos));
+    // full resync, device state is unknown after reset
+    FlushSurfaceState(true);
 
     if (m_midiout)
     {
       if (!m_is_mcuex)
       {
-        m_midiout->Send(0x90, 0x32, m_flipmode ? 1 : 0, -1);
-        m_midiout->Send(0x90, 0x33, g_csurf_mcpmode ? 0x7f : 0, -1);
+        SetNote(0x32, m_flipmode ? 1 : 0);
+        SetNote(0x33, g_csurf_mcpmode ? 0x7f : 0);
 
-        m_midiout->Send(0x90, 0x64, (m_mackie_arrow_states & 64) ? 0x7f : 0,
-                        -1);
-        m_midiout->Send(0x90, 0x65, (m_mackie_arrow_states & 128) ? 0x7f : 0,
-                        -1);
+        SetNote(0x64, (m_mackie_arrow_states & 64) ? 0x7f : 0);
+        SetNote(0x65, (m_mackie_arrow_states & 128) ? 0x7f : 0);
 
-        m_midiout->Send(0xB0, 0x40 + 11,
-                        '0' + (((g_allmcus_bank_offset + 1) / 10) % 10), -1);
-        m_midiout->Send(0xB0, 0x40 + 10,
-                        '0' + ((g_allmcus_bank_offset + 1) % 10), -1);
+        SetCC(0x40 + 11, '0' + (((g_allmcus_bank_offset + 1) / 10) % 10));
+        SetCC(0x40 + 10, '0' + ((g_allmcus_bank_offset + 1) % 10));
       }
 
       UpdateMackieDisplay(0, SPLASH_MESSAGE, 56 * 2);
@@ -333,10 +676,8 @@ public:
         wr[6] = 0x00 + x;
         wr[7] = 0x03;
         wr[8] = 0xF7;
-        Sleep(5);
         m_midiout->SendMsg(&evt.evt, -1);
       }
-      Sleep(5);
       for (x = 0; x < 8; x++)
       {
         m_midiout->Send(0xD0, (x << 4) | 0xF, 0, -1);
@@ -344,12 +685,13 @@ public:
     }
   }
 
-  void UpdateMackieDisplay(int pos, const char* text, int pad)
+  // sends LCD chars as is, see UpdateMackieDisplay
+  void SendMackieDisplay(int pos, const char* text, int len)
   {
     struct
     {
       MIDI_event_t evt;
-      char data[2 * BUFSIZ];
+      char data[LCD_SIZE + LCD_SYSEX_OVERHEAD];
     } evt;
 
     evt.evt.frame_offset = 0;
@@ -363,23 +705,70 @@ public:
     wr[6] = (unsigned char)pos;
     evt.evt.size = 7;
 
+    memcpy(wr + evt.evt.size, text, len);
+    memcpy(m_lcd + pos, text, len);
+    evt.evt.size += len;
+    wr[evt.evt.size++] = 0xF7;
+    m_midiout->SendMsg(&evt.evt, -1);
+  }
+
+  // Writes text padded with spaces to pad chars at pos. Only the spans that
+  // differ from what the LCD already shows are sent, spans closer than a
+  // SysEx header are merged.
+  void UpdateMackieDisplay(int pos, const char* text, int pad)
+  {
+    if (!m_midiout || pos < 0 || pos >= LCD_SIZE)
+      return;
+
+    if (pad > LCD_SIZE - pos)
+      pad = LCD_SIZE - pos;
+
+    char buf[LCD_SIZE];
     int l = (int)strlen(text);
     if (pad < l)
       l = pad;
-    if (l > 200)
-      l = 200;
+    memcpy(buf, text, l);
+    memset(buf + l, ' ', pad - l);
+
+    const char* lcd = m_lcd + pos;
+    int i = 0;
+    while (i < pad)
+    {
+      if (buf[i] == lcd[i])
+      {
+        i++;
+        continue;
+      }
+      int end = i + 1;
+      for (int j = end; j < pad && j - end <= LCD_SYSEX_OVERHEAD; j++)
+      {
+        if (buf[j] != lcd[j])
+          end = j + 1;
+      }
+      SendMackieDisplay(pos + i, buf + i, end - i);
+      i = end;
+    }
+  }
 
-    int cnt = 0;
-    while (cnt < l)
+  // raw SysEx bypassed m_lcd: LCD write forgets the chars it covers, any
+  // other SysEx may have changed anything so all of m_lcd is forgotten
+  void InvalidateMackieDisplay(const unsigned char* msg, int len)
+  {
+    if (len < 1 || msg[0] != 0xF0)
+      return;
+    if (len > 7 && msg[1] == 0x00 && msg[2] == 0x00 && msg[3] == 0x66 &&
+        msg[4] == (m_is_mcuex ? 0x15 : 0x14) && msg[5] == 0x12 &&
+        msg[6] < LCD_SIZE)
     {
-      wr[evt.evt.size++] = *text++;
-      cnt++;
+      int n = len - 7;
+      if (msg[len - 1] == 0xF7)
+        n--;
+      if (n > LCD_SIZE - msg[6])
+        n = LCD_SIZE - msg[6];
+      memset(m_lcd + msg[6], 0, n);
+      return;
     }
-    while (cnt++ < pad)
-      wr[evt.evt.size++] = ' ';
-    wr[evt.evt.size++] = 0xF7;
-    Sleep(5);
-    m_midiout->SendMsg(&evt.evt, -1);
+    memset(m_lcd, 0, sizeof(m_lcd));
   }
 
   typedef bool (CSurf_MCULive::*MidiHandlerFunc)(MIDI_event_t*);
@@ -426,8 +815,7 @@ public:
         else if (m_fader_pos[tid] != faderVal)
         {
           m_fader_pos[tid] = faderVal;
-          m_midiout->Send(0xe0 + (tid & 0xf), faderVal & 0x7f,
-                          (faderVal >> 7) & 0x7f, -1);
+          SetFader(tid, faderVal);
         }
         return true;
       }
@@ -481,28 +869,20 @@ public:
         }
         if (m_mode == 2)
         {
-          MediaTrack* dst{nullptr};
-          for (int i = 0; i < GetTrackNumSends(tr, 0); i++)
+          auto i = GetSendIndex(tr);
+          if (i < 0)
           {
-            dst = (MediaTrack*)(uintptr_t)GetTrackSendInfo_Value(tr, 0, i,
-                                                                 "P_DESTTRACK");
-            if (GetSelectedTrack(0, 0) == dst)
-            {
-              if (m_flipmode)
-              {
-                (void)CSurf_OnSendPanChange(tr, i, val, false);
-              }
-              else
-              {
-                (void)CSurf_OnSendVolumeChange(tr, i, val, false);
-              }
-              break;
-            }
+            return true; // send not found
           }
-          if (GetSelectedTrack(0, 0) != dst)
+          if (m_flipmode)
           {
-            return true; // send not found
+            (void)CSurf_OnSendPanChange(tr, i, val, false);
+          }
+          else
+          {
+            (void)CSurf_OnSendVolumeChange(tr, i, val, false);
           }
+          InvalidateRefreshCache();
         }
       }
       return true;
@@ -562,28 +942,20 @@ public:
 
         if (m_mode == 2)
         {
-          MediaTrack* dst{nullptr};
-          for (int i = 0; i < GetTrackNumSends(tr, 0); i++)
+          auto i = GetSendIndex(tr);
+          if (i < 0)
           {
-            dst = (MediaTrack*)(uintptr_t)GetTrackSendInfo_Value(tr, 0, i,
-                                                                 "P_DESTTRACK");
-            if (GetSelectedTrack(0, 0) == dst)
-            {
-              if (m_flipmode)
-              {
-                (void)CSurf_OnSendVolumeChange(tr, i, adj * 11.0, true);
-              }
-              else
-              {
-                (void)CSurf_OnSendPanChange(tr, i, adj, true);
-              }
-              break;
-            }
+            return true; // send not found
           }
-          if (GetSelectedTrack(0, 0) != dst)
+          if (m_flipmode)
           {
-            return true; // send not found
+            (void)CSurf_OnSendVolumeChange(tr, i, adj * 11.0, true);
           }
+          else
+          {
+            (void)CSurf_OnSendPanChange(tr, i, adj, true);
+          }
+          InvalidateRefreshCache();
         }
       }
       return true;
@@ -639,18 +1011,62 @@ public:
     return true;
   }
 
-  int GetSendIndex(MediaTrack* src, MediaTrack* dst = GetSelectedTrack(0, 0))
+  int GetSendIndex(MediaTrack* src, MediaTrack* dst = GetSelectedTrackCached())
   {
-    for (int i = 0; i < GetTrackNumSends(src, 0); i++)
+    if (!src || !dst)
+    {
+      return -1;
+    }
+    const int nsends = GetTrackNumSends(src, 0);
+    auto it = g_send_index.find(src);
+    if (it != g_send_index.end() && it->second.dst == dst &&
+        it->second.nsends == nsends &&
+        (MediaTrack*)(uintptr_t)GetTrackSendInfo_Value(
+          src, 0, it->second.idx, "P_DESTTRACK") == dst)
+    {
+      return it->second.idx;
+    }
+
+    int res = -1;
+    for (int i = 0; i < nsends; i++)
     {
       auto tr = (MediaTrack*)(uintptr_t)GetTrackSendInfo_Value(src, 0, i,
                                                                "P_DESTTRACK");
       if (tr == dst)
       {
-        return i;
+        res = i;
+        break;
       }
     }
-    return -1;
+    if (res >= 0)
+      g_send_index[src] = {dst, res, nsends};
+    else if (it != g_send_index.end())
+      g_send_index.erase(it);
+    return res;
+  }
+
+  // send from tr to selected track, what is REFRESH_SEND_*
+  RefreshCacheEntry* GetRefreshSend(MediaTrack* tr, int what)
+  {
+    auto e = GetRefreshCache(tr);
+    auto dst = GetSelectedTrackCached();
+    if (e->send_dst != dst || !(e->send_have & REFRESH_SEND_IDX))
+    {
+      e->send_dst = dst;
+      e->send_idx = GetSendIndex(tr, dst);
+      e->send_have = REFRESH_SEND_IDX;
+    }
+    what &= ~e->send_have;
+    if (what & REFRESH_SEND_VOL)
+      e->send_vol = e->send_idx >= 0 ? GetTrackSendInfo_Value(
+                                         tr, 0, e->send_idx, "D_VOL")
+                                     : 0.0;
+    if (what & REFRESH_SEND_PAN)
+      e->send_pan = GetTrackSendInfo_Value(tr, 0, e->send_idx, "D_PAN");
+    if (what & REFRESH_SEND_MUTE)
+      e->send_mute = isSendMuted(tr, e->send_idx);
+    e->send_have |= what;
+    return e;
   }
 
   bool isSendMuted(MediaTrack* tr, int idx)
@@ -681,11 +1097,13 @@ public:
           auto idx = GetSendIndex(tr);
           if (idx < 0)
           {
-            idx = CreateTrackSend(tr, GetSelectedTrack(0, 0));
+            idx = CreateTrackSend(tr, GetSelectedTrackCached());
+            g_send_index.erase(tr);
             SetTrackSendInfo_Value(tr, 0, idx, "B_MUTE", 1);
           }
           auto isMuted = isSendMuted(tr, idx);
           SetTrackSendInfo_Value(tr, 0, idx, "B_MUTE", !isMuted);
+          InvalidateRefreshCache();
           SetSurfaceMute(tr, !isMuted);
         }
         else
@@ -806,16 +1224,7 @@ public:
       {
         for (int i = 0; i < 6; i++)
         {
-          if (mcu->m_modemask & 1 << i && !(modemask & 1 << i))
-          {
-            if (mcu->m_midiout)
-              mcu->m_midiout->Send(0x90, 0x28 + i, 0, -1);
-          }
-          if (modemask & 1 << i)
-          {
-            if (mcu->m_midiout)
-              mcu->m_midiout->Send(0x90, 0x28 + i, 1, -1);
-          }
+          mcu->SetNote(0x28 + i, modemask & 1 << i ? 1 : 0);
         }
 
         mcu->m_modemask = modemask;
@@ -870,8 +1279,7 @@ public:
       return false;
     };
     m_flipmode = ~m_flipmode;
-    if (m_midiout)
-      m_midiout->Send(0x90, 0x32, m_flipmode ? 1 : 0, -1);
+    SetNote(0x32, m_flipmode ? 1 : 0);
     CSurf_ResetAllCachedVolPanStates();
     TrackList_UpdateAllExternalSurfaces();
     return true;
@@ -941,42 +1349,51 @@ public:
     return true;
   }
 
-  struct ButtonHandler
+  ButtonRoute<MidiHandlerFunc> m_button_routes[256];
+
+  void BuildButtonRoutes()
   {
-    unsigned int evt_min;
-    unsigned int evt_max; // inclusive
-    MidiHandlerFunc func;
-    MidiHandlerFunc func_dc;
-  };
+    static const int nHandlers = 11;
+    static const int nPressOnlyHandlers = 5;
+    static const ButtonHandler<MidiHandlerFunc> handlers[nHandlers] = {
+      //
+      {0x00, 0x07, &CSurf_MCULive::OnRecArm, NULL},
+      {0x08, 0x0f, NULL, &CSurf_MCULive::OnSoloDC},
+      {0x08, 0x17, &CSurf_MCULive::OnMuteSolo, NULL},
+      {0x18, 0x1f, &CSurf_MCULive::OnChannelSelectDC,
+       &CSurf_MCULive::OnChannelSelect},
+      {0x2e, 0x31, &CSurf_MCULive::OnBankChannel, NULL},
+      // Press and release events
+      {0x32, 0x45, &CSurf_MCULive::OnMCULiveButton, NULL},
+      {0x4a, 0x5f, &CSurf_MCULive::OnMCULiveButton, NULL},
+      {0x64, 0x67, &CSurf_MCULive::OnMCULiveButton, NULL},
+      {0x46, 0x49, &CSurf_MCULive::OnKeyModifier},
+      {0x60, 0x63, &CSurf_MCULive::OnScroll},
+      {0x68, 0x70, &CSurf_MCULive::OnTouch},
+    };
+
+    ResolveButtonRoutes(m_button_routes, handlers, nHandlers,
+                        nPressOnlyHandlers, m_button_remap,
+                        m_buttons_passthrough, m_press_only_buttons);
+  }
 
   bool OnButtonPress(MIDI_event_t* evt)
   {
     if ((evt->midi_message[0] & 0xf0) != 0x90)
       return false;
 
-    if (m_button_remap[evt->midi_message[1]])
-    {
-      evt->midi_message[1] = m_button_remap[evt->midi_message[1]];
-    }
+    const ButtonRoute<MidiHandlerFunc>* r =
+      &m_button_routes[evt->midi_message[1]];
+    evt->midi_message[1] = r->code;
 
     m_button_states[evt->midi_message[1]] = evt->midi_message[2];
 
     unsigned int evt_code = evt->midi_message[1]; // get_midi_evt_code( evt );
 
-    if (m_buttons_passthrough[evt_code])
+    if (r->passthrough)
     { // Pass thru if not otherwise
       // handled
-      if (evt->midi_message[2] >= 0x40)
-      {
-        int a = evt->midi_message[1];
-        MIDI_event_t evt = {0,
-                            3,
-                            {(unsigned char)(0xbf - (m_mackie_modifiers & 15)),
-                             (unsigned char)a, 0}};
-        kbd_OnMidiEvent(&evt, -1);
-        return true;
-      }
-      else if (!m_press_only_buttons[evt_code])
+      if (evt->midi_message[2] >= 0x40 || !r->press_only)
       {
         int a = evt->midi_message[1];
         MIDI_event_t evt = {0,
@@ -993,74 +1410,93 @@ public:
       return true;
     }
 
-    static const int nHandlers = 11;
-    static const int nPressOnlyHandlers = 5;
-    static const ButtonHandler handlers[nHandlers] = {
-      //
-      {0x00, 0x07, &CSurf_MCULive::OnRecArm, NULL},
-      {0x08, 0x0f, NULL, &CSurf_MCULive::OnSoloDC},
-      {0x08, 0x17, &CSurf_MCULive::OnMuteSolo, NULL},
-      {0x18, 0x1f, &CSurf_MCULive::OnChannelSelectDC,
-       &CSurf_MCULive::OnChannelSelect},
-      {0x2e, 0x31, &CSurf_MCULive::OnBankChannel, NULL},
-      // Press and release events
-      {0x32, 0x45, &CSurf_MCULive::OnMCULiveButton, NULL},
-      {0x4a, 0x5f, &CSurf_MCULive::OnMCULiveButton, NULL},
-      {0x64, 0x67, &CSurf_MCULive::OnMCULiveButton, NULL},
-      {0x46, 0x49, &CSurf_MCULive::OnKeyModifier},
-      {0x60, 0x63, &CSurf_MCULive::OnScroll},
-      {0x68, 0x70, &CSurf_MCULive::OnTouch},
-    };
-
-#if 0
-      char buf[512];
-      sprintf( buf, "   0x%08x %02x %02x %02x %02x 0x%08x 0x%08x %s", evt_code,
-          evt->midi_message[0], evt->midi_message[1], evt->midi_message[2], evt->midi_message[3],
-          handlers[0].evt_min, handlers[0].evt_max, 
-          handlers[0].evt_min <= evt_code && evt_code <= handlers[0].evt_max ? "yes" : "no" );
-      UpdateMackieDisplay( 0, buf, 56 );
-#endif
-
     // For these events we only want to track button press
-    if (m_press_only_buttons[evt_code] && evt->midi_message[2] >= 0x40)
+    if (r->press_only)
     {
-      // Check for double click
-      double now = time_precise(); // timeGetTime();
-      bool double_click = (int)evt_code == m_button_last &&
-                          now - m_button_last_time < DOUBLE_CLICK_INTERVAL;
-      m_button_last = evt_code;
-      m_button_last_time = now;
-
-      // Find event handler
-      // for (int i = 0; i < nPressOnlyHandlers; i++) {
-      for (int i = 0; i < nHandlers; i++)
+      if (evt->midi_message[2] >= 0x40)
       {
-        ButtonHandler bh = handlers[i];
-        if (bh.evt_min <= evt_code && evt_code <= bh.evt_max)
-        {
-          // Try double click first
-          if (double_click && bh.func_dc != NULL)
-            if ((this->*bh.func_dc)(evt))
-              return true;
-
-          // Single click (and unhandled double clicks)
-          if (bh.func != NULL)
-            if ((this->*bh.func)(evt))
-              return true;
-        }
+        // Check for double click
+        double now = time_precise(); // timeGetTime();
+        bool double_click = (int)evt_code == m_button_last &&
+                            now - m_button_last_time < DOUBLE_CLICK_INTERVAL;
+        m_button_last = evt_code;
+        m_button_last_time = now;
+
+        // Try double click first
+        if (double_click && r->press_dc)
+          if ((this->*r->press_dc)(evt))
+            return true;
+
+        // Single click (and unhandled double clicks)
+        if (r->press)
+          (this->*r->press)(evt);
       }
     }
-
     // For these events we want press and release
-    for (int i = nPressOnlyHandlers; i < nHandlers; i++)
-      if (!m_press_only_buttons[evt_code] && handlers[i].evt_min <= evt_code &&
-          evt_code <= handlers[i].evt_max)
-        if ((this->*handlers[i].func)(evt))
-          return true;
+    else if (r->any)
+    {
+      (this->*r->any)(evt);
+    }
 
     return true;
   }
 
+  // Keeps last absolute fader value and sums V-Pot deltas. Returns false
+  // for other messages, which must flush pending ones first to keep order.
+  bool CoalesceInput(const MIDI_event_t* evt)
+  {
+    const unsigned char* msg = evt->midi_message;
+    if ((msg[0] & 0xf0) == 0xe0)
+    {
+      m_pending_fader[msg[0] & 0xf] = *evt;
+      m_pending_faders |= 1 << (msg[0] & 0xf);
+      return true;
+    }
+    if ((msg[0] & 0xf0) == 0xb0 && msg[1] >= 0x10 && msg[1] < 0x18)
+    {
+      int delta = msg[2] & 0x3f;
+      m_pending_encoder[msg[1] - 0x10] += msg[2] & 0x40 ? -delta : delta;
+      m_pending_encoder_frame = evt->frame_offset;
+      return true;
+    }
+    return false;
+  }
+
+  void FlushInput()
+  {
+    for (int x = 0; m_pending_faders; x++)
+    {
+      if (m_pending_faders & (1 << x))
+      {
+        m_pending_faders &= ~(1 << x);
+        OnMIDIEvent(&m_pending_fader[x]);
+      }
+    }
+    for (int x = 0; x < 8; x++)
+    {
+      // relative encoding carries 6 bits, larger sums go in steps
+      while (m_pending_encoder[x])
+      {
+        int delta = std::clamp(m_pending_encoder[x], -0x3f, 0x3f);
+        m_pending_encoder[x] -= delta;
+        MIDI_event_t evt = {
+          m_pending_encoder_frame,
+          3,
+          {0xb0, (unsigned char)(0x10 + x),
+           (unsigned char)(delta < 0 ? 0x40 | -delta : delta)}};
+        OnMIDIEvent(&evt);
+      }
+    }
+  }
+
+  // 0xb0: encoders and jog wheel
+  bool OnControlChange(MIDI_event_t* evt)
+  {
+    if (evt->midi_message[1] == 0x3c)
+      return OnJogWheel(evt);
+    return OnRotaryEncoder(evt);
+  }
+
   void OnMIDIEvent(MIDI_event_t* evt)
   {
 #if 0
@@ -1074,15 +1510,28 @@ public:
         OutputDebugString(buf);
 #endif
 
-    static const int nHandlers = 5;
-    static const MidiHandlerFunc handlers[nHandlers] = {
-      &CSurf_MCULive::OnMCUReset,      &CSurf_MCULive::OnFaderMove,
-      &CSurf_MCULive::OnRotaryEncoder, &CSurf_MCULive::OnJogWheel,
-      &CSurf_MCULive::OnButtonPress,
+    // by status nibble, buttons are then routed by note in OnButtonPress
+    static const MidiHandlerFunc handlers[16] = {
+      NULL,
+      NULL,
+      NULL,
+      NULL,
+      NULL,
+      NULL,
+      NULL,
+      NULL,
+      NULL,
+      &CSurf_MCULive::OnButtonPress,   // 0x90
+      NULL,
+      &CSurf_MCULive::OnControlChange, // 0xb0
+      NULL,
+      NULL,
+      &CSurf_MCULive::OnFaderMove, // 0xe0
+      &CSurf_MCULive::OnMCUReset,  // 0xf0
     };
-    for (int i = 0; i < nHandlers; i++)
-      if ((this->*handlers[i])(evt))
-        return;
+    MidiHandlerFunc func = handlers[evt->midi_message[0] >> 4];
+    if (func)
+      (this->*func)(evt);
   }
 
   static bool CompareMCULiveOffset(const ReaMCULive::CSurf_MCULive* a,
@@ -1113,10 +1562,16 @@ public:
 
     // init locals
     for (int x = 0; x < sizeof(m_mcu_meterpos) / sizeof(m_mcu_meterpos[0]); x++)
-      m_mcu_meterpos[x] = -100000.0;
+    {
+      m_mcu_meterpos[x] = 0.0;
+      m_mcu_meter_sent[x] = -1;
+      m_mcu_meter_senttime[x] = 0.0;
+      m_mcu_meter_falltime[x] = 0.0;
+    }
     m_mcu_timedisp_lastforce = 0;
     m_mcu_meter_lastrun = 0;
-    memset(m_fader_touchstate, 0, sizeof(m_fader_touchstate));
+    for (auto& t : m_fader_touchstate)
+      t.store(0, std::memory_order_relaxed);
     memset(m_fader_lasttouch, 0, sizeof(m_fader_lasttouch));
     memset(m_pan_lasttouch, 0, sizeof(m_pan_lasttouch));
 
@@ -1125,18 +1580,22 @@ public:
     memset(m_buttons_passthrough, 1, sizeof(m_buttons_passthrough));
     memset(m_press_only_buttons, 1, sizeof(m_press_only_buttons));
     memset(m_button_states, 0, sizeof(m_button_states));
+    memset(&m_state, 0xff, sizeof(m_state));
+    memset(&m_shown, 0xff, sizeof(m_shown));
 
     // m_button_remap[0x32] = 0x29; // flip to sends
     for (int i = 0; i <= 0x32; i++)
     {
       m_buttons_passthrough[i] = 0;
     }
+    BuildButtonRoutes();
 
     // create midi hardware access
     m_midiin = m_midi_in_dev >= 0 ? CreateMIDIInput(m_midi_in_dev) : NULL;
     m_midiout = m_midi_out_dev >= 0 ? CreateThreadedMIDIOutput(CreateMIDIOutput(
                                         m_midi_out_dev, false, NULL))
                                     : NULL;
+    SetThreadedMIDIOutputHook(m_midiout, OnOutputTrace, this);
 
     if (errStats)
     {
@@ -1180,9 +1639,7 @@ public:
       wr[5] = 0x08;
       wr[6] = 0x00;
       wr[7] = 0xF7;
-      Sleep(5);
       m_midiout->SendMsg(&evt.evt, -1);
-      Sleep(5);
 
 #elif 0
       char bla[11] = {"          "};
@@ -1192,6 +1649,7 @@ public:
       UpdateMackieDisplay(0, "", 56 * 2);
 #endif
     }
+    SetInputThread(false);
     DELETE_ASYNC(m_midiout);
     DELETE_ASYNC(m_midiin);
     // while (m_schedule != NULL) {
@@ -1219,56 +1677,316 @@ public:
   const char* GetConfigString() // string of configuration data
   {
     snprintf(m_configtmp, sizeof(m_configtmp), "%d %d %d %d %d", m_offset,
-             m_size, m_midi_in_dev, m_midi_out_dev, m_cfg_flags);
+             m_size, m_midi_in_dev, m_midi_out_dev, m_cfg_flags.load());
     return m_configtmp;
   }
 
   void CloseNoReset()
   {
+    SetInputThread(false);
     DELETE_ASYNC(m_midiout);
     DELETE_ASYNC(m_midiin);
     m_midiout = 0;
     m_midiin = 0;
+    m_virtual_out = false;
+    m_capture_enabled = false;
   }
 
   void RunOutput(double now);
 
+  // one line JSON, times in microseconds
+  void FormatStats(WDL_String* str)
+  {
+    MIDIOutputStats out{};
+    GetThreadedMIDIOutputStats(m_midiout, &out);
+    str->SetFormatted(
+      512,
+      "{\"in\":%u,\"in_queue_max\":%d,\"in_dropped\":%u,"
+      "\"in_thread_dropped\":%u,\"out\":%u,\"out_bytes\":%u,"
+      "\"out_sent\":%u,\"out_sent_bytes\":%u,\"out_dropped\":%u,"
+      "\"out_coalesced\":%u,\"out_queued\":%u,\"out_queue_max\":%u",
+      m_stats.events_in, m_stats.input_queue_max, midiBuffer.GetDropped(),
+      m_input_thread ? GetMIDIInputThreadDropped(m_input_thread) : 0,
+      out.enqueued, out.enqueued_bytes, out.sent, out.bytes, out.dropped,
+      out.coalesced, out.queued, out.queued_max);
+    for (int i = 0; i < STAT_STAGES; i++)
+    {
+      const StageStats& st = m_stats.stage[i];
+      str->AppendFormatted(
+        256, ",\"%s\":{\"count\":%u,\"total_us\":%.0f,\"max_us\":%.1f,"
+             "\"hist\":[",
+        g_stat_names[i], st.count, st.total * 1000000.0, st.max * 1000000.0);
+      for (int b = 0; b < STATS_BUCKETS; b++)
+        str->AppendFormatted(32, b ? ",%u" : "%u", st.hist[b]);
+      str->Append("]}");
+    }
+    str->Append("}");
+  }
+
+  static void DumpStats()
+  {
+    WDL_String str;
+    for (int i = 0; i < (int)g_mcu_list.size(); i++)
+    {
+      WDL_String line;
+      g_mcu_list[i]->FormatStats(&line);
+      str.AppendFormatted(64, "MCULive %d: ", i);
+      str.Append(line.Get());
+      str.Append("\n");
+    }
+    ShowConsoleMsg(str.Get());
+  }
+
+  // Returns segment to send, or -1 if peak is below falling hold or device
+  // already shows segment. decay is GetMeterDecay() of time since last
+  // update of meter x, so RunMeters() and MCULive_SetMeterValue can both
+  // update it.
+  int UpdateMeter(int x, double peak, double now, double decay)
+  {
+    if (m_mcu_meterpos[x] > VU_HOLD_MIN && m_mcu_meter_falltime[x])
+      m_mcu_meterpos[x] *= decay;
+    m_mcu_meter_falltime[x] = now;
+    if (peak < m_mcu_meterpos[x])
+      return -1;
+    m_mcu_meterpos[x] = peak;
+
+    int v = GetMeterSegment(peak);
+    if (v == m_mcu_meter_sent[x] &&
+        (!v || now < m_mcu_meter_senttime[x] + VU_REFRESH))
+      return -1;
+    m_mcu_meter_sent[x] = v;
+    m_mcu_meter_senttime[x] = now;
+    return v;
+  }
+
+  // own rate, see SetDeviceOption
+  void RunMeters(double now)
+  {
+    if (!m_midiout)
+      return;
+
+    // one fall for meters last updated by previous run, others were set
+    // through MCULive_SetMeterValue since and fall from their own time
+    double last = m_mcu_meter_lastrun;
+    double decay = GetMeterDecay(now - last);
+    m_mcu_meter_lastrun = now;
+    for (int x = 0; x < 8; x++)
+    {
+      MediaTrack* t = CSurf_TrackFromID(GetBankOffset() + x, g_csurf_mcpmode);
+      if (!t)
+        continue;
+      double peak = (Track_GetPeakInfo(t, 0) + Track_GetPeakInfo(t, 1)) * 0.5;
+      double fall = m_mcu_meter_falltime[x];
+      int v = UpdateMeter(x, peak, now,
+                          fall == last ? decay : GetMeterDecay(now - fall));
+      if (v >= 0)
+        m_midiout->Send(0xD0, (x << 4) | v, 0, -1);
+    }
+  }
+
+  // Input thread: touch state right away, in non-default mode also fader
+  // echo through separate output lane. Rest is done in Run().
+  static void OnInputThreadEvent(void* ctx, const MIDI_event_t* evt)
+  {
+    auto mcu = (CSurf_MCULive*)ctx;
+    const unsigned char* msg = evt->midi_message;
+    if ((msg[0] & 0xf0) == 0x90 && msg[1] >= 0x68 && msg[1] <= 0x70)
+    {
+      mcu->m_fader_touchstate[msg[1] - 0x68].store(msg[2] >= 0x7f,
+                                                   std::memory_order_relaxed);
+      return;
+    }
+    if ((msg[0] & 0xf0) != 0xe0 ||
+        mcu->m_is_default.load(std::memory_order_relaxed))
+      return;
+
+    int flags = mcu->m_cfg_flags.load(std::memory_order_relaxed);
+    if (!(flags & CONFIG_FLAG_FADER_TOUCH_MODE) ||
+        mcu->m_fader_touchstate[msg[0] & 0xf].load(std::memory_order_relaxed))
+    {
+      SendThreadedMIDIOutputEcho(mcu->m_midiout, evt);
+    }
+  }
+
+  static void OnOutputTrace(void* ctx, const MIDI_event_t* evt)
+  {
+    ((CSurf_MCULive*)ctx)->m_trace.AddMIDI(time_precise(), TRACE_OUT, evt);
+  }
+
+  // Loads TRACE_IN records of dumped trace, replayed through m_inject with
+  // original timing. Empty filename stops replay.
+  int ReplayTrace(const char* filename)
+  {
+    m_replay.clear();
+    m_replay_pos = 0;
+    if (!filename || !*filename)
+      return 0;
+
+    std::vector<TraceRecord> records;
+    FILE* fp = fopen(filename, "rb");
+    if (!fp)
+      return -1;
+    bool ok = SurfaceTrace::Read(fp, &records);
+    fclose(fp);
+    if (!ok)
+      return -1;
+
+    for (auto& rec : records)
+    {
+      if (rec.type == TRACE_IN && rec.size > 0 && rec.size <= 4)
+        m_replay.push_back(rec);
+    }
+    m_replay_start = time_precise();
+    return (int)m_replay.size();
+  }
+
+  // Copies output to m_capture. Without output device, virtual output is
+  // created so surface is fully driven.
+  void SetCapture(bool enable)
+  {
+    m_capture_enabled = enable;
+    if (enable && !m_midiout)
+    {
+      m_midiout = CreateVirtualMIDIOutput();
+      m_virtual_out = true;
+      SetThreadedMIDIOutputHook(m_midiout, OnOutputTrace, this);
+      FlushSurfaceState(true);
+    }
+    m_capture.Clear();
+    SetThreadedMIDIOutputCapture(m_midiout, enable ? &m_capture : NULL);
+  }
+
+  bool SetInputThread(bool enable)
+  {
+    if (!enable && m_input_thread)
+    {
+      DestroyMIDIInputThread(m_input_thread);
+      m_input_thread = NULL;
+    }
+    else if (enable && !m_input_thread && m_midiin)
+    {
+      m_input_lastrun = time_precise();
+      m_input_thread =
+        CreateMIDIInputThread(m_midiin, OnInputThreadEvent, this);
+    }
+    return !!m_input_thread == enable;
+  }
+
+  void OnInputEvent(MIDI_event_t* evt, double time)
+  {
+    StatTimer timer(m_stats, STAT_INPUT);
+    m_stats.events_in++;
+    m_trace.AddMIDI(time, TRACE_IN, evt);
+    midiBuffer.Push(evt);
+    if (midiBuffer.GetSize() > m_stats.input_queue_max)
+      m_stats.input_queue_max = midiBuffer.GetSize();
+    if (m_is_default)
+    {
+      if (m_input_coalesce && CoalesceInput(evt))
+        return;
+      FlushInput();
+      OnMIDIEvent(evt);
+    }
+    else if (m_input_thread && (evt->midi_message[0] & 0xf0) == 0xe0)
+    {
+      // echoed by input thread, device now shows this value
+      m_shown.pitch[evt->midi_message[0] & 0xf] =
+        (evt->midi_message[1] & 0x7f) | ((evt->midi_message[2] & 0x7f) << 7);
+    }
+  }
+
   void Run()
   {
+    StatTimer timer(m_stats, STAT_RUN);
     auto now = time_precise(); // timeGetTime();
     auto x = now - m_frameupd_lastrun;
     auto y = 1. / std::max((*g_config_csurf_rate), 1);
 
-    if (!m_is_default)
+    if (this == g_mcu_list[0])
     {
-      return;
+      InvalidateRefreshCache();
     }
 
-    if (x >= y)
+    if (g_stats_dump_interval > 0 && this == g_mcu_list[0] &&
+        now >= g_stats_dump_lastrun + g_stats_dump_interval)
+    {
+      g_stats_dump_lastrun = now;
+      DumpStats();
+    }
+
+    // input is still buffered for scripts when default operation is off
+    if (m_is_default && x >= y)
     {
       m_frameupd_lastrun = now;
 
+      StatTimer stage(m_stats, STAT_RUN_OUTPUT);
       RunOutput(now);
     }
 
-    if (m_midiin)
+    if (m_is_default &&
+        now - m_mcu_meter_lastrun >= (m_meter_rate > 0 ? 1. / m_meter_rate : y))
+    {
+      StatTimer stage(m_stats, STAT_RUN_METERS);
+      RunMeters(now);
+    }
+
+    while (m_replay_pos < m_replay.size() &&
+           m_replay[m_replay_pos].time - m_replay[0].time <=
+             now - m_replay_start)
+    {
+      const TraceRecord& rec = m_replay[m_replay_pos++];
+      MIDI_event_t evt = {0, rec.size,
+                          {rec.msg[0], rec.msg[1], rec.msg[2], rec.msg[3]}};
+      m_inject.Push(&evt);
+    }
+
+    if (!m_inject.IsEmpty())
     {
-      if (midiBuffer.size() > BUFSIZ)
+      for (int i = 0; i < m_inject.GetSize(); i++)
       {
-        midiBuffer.clear();
+        struct
+        {
+          MIDI_event_t evt;
+          char data[4];
+        } evt;
+        int sz, frame_offset;
+        auto msg = m_inject.Get(i, &sz, &frame_offset);
+        evt.evt.frame_offset = frame_offset;
+        evt.evt.size = sz;
+        memcpy(evt.evt.midi_message, msg, sz);
+        OnInputEvent(&evt.evt, now);
       }
-      m_midiin->SwapBufsPrecise(0, now);
-      int l = 0;
-      MIDI_eventlist* list = m_midiin->GetReadBuf();
+      m_inject.Clear();
+      FlushInput();
+    }
+
+    if (m_midiin)
+    {
       MIDI_event_t* evts;
-      while ((evts = list->EnumItems(&l)))
+      if (m_input_thread)
       {
-        midiBuffer.push_back(*evts);
-        if (m_is_default)
+        // frame_offset relative to previous Run(), as when read here
+        double t;
+        while ((evts = GetMIDIInputThreadEvent(m_input_thread, &t)))
         {
-          OnMIDIEvent(evts);
+          evts->frame_offset =
+            t > m_input_lastrun ? (int)((t - m_input_lastrun) * 1024000.0) : 0;
+          OnInputEvent(evts, t);
+          PopMIDIInputThreadEvent(m_input_thread);
         }
+        m_input_lastrun = now;
       }
+      else
+      {
+        m_midiin->SwapBufsPrecise(0, now);
+        int l = 0;
+        MIDI_eventlist* list = m_midiin->GetReadBuf();
+        while ((evts = list->EnumItems(&l)))
+        {
+          OnInputEvent(evts, now);
+        }
+      }
+      FlushInput();
       if (m_mackie_arrow_states)
       {
         if ((now - m_buttonstate_lastrun) >= 0.1)
@@ -1299,66 +2017,122 @@ public:
     }
   }
 
-  void SetTrackListChange()
+  void SetTrackListChange()
+  {
+    g_refresh_cache.clear();
+    InvalidateRefreshCache();
+    m_trace.AddCallback(time_precise(), TRACE_TRACKLIST_CHANGE, -1, 0);
+    InvalidateTrackIndex();
+    InvalidateOutputTrack();
+    InvalidateSendIndex();
+    if (m_midiout)
+    {
+      int x;
+      for (x = 0; x < 8; x++)
+      {
+        MediaTrack* t = CSurf_TrackFromID(x + GetBankOffset(), g_csurf_mcpmode);
+        // REAPER pushes rest after this
+        m_strip_track[x] = t;
+        m_strip_valid |= 1 << x;
+        if (!t || t == CSurf_TrackFromID(0, false))
+        {
+          ClearStrip(x);
+        }
+      }
+    }
+  }
+
+  void ClearStrip(int x)
+  {
+    int panint = m_flipmode ? panToInt14(0.0) : volToInt14(0.0);
+    unsigned char volch = m_flipmode ? volToChar(0.0) : panToChar(0.0);
+
+    SetFader(x, panint);
+    SetCC(0x30 + x, 1 + ((volch * 11) >> 7));
+
+    SetNote(0x10 + x, 0); // reset mute
+    SetNote(0x18 + x, 0); // reset selected
+
+    SetNote(0x08 + x, 0); // reset solo
+    // 0x00 + x is left alone, rec arm LEDs show bank page (m_page)
+
+    char buf[7] = {
+      0,
+    };
+    UpdateMackieDisplay(x * 7, buf, 7); // clear display
+
+    struct
+    {
+      MIDI_event_t evt;
+      char data[9];
+    } evt;
+
+    evt.evt.frame_offset = 0;
+    evt.evt.size = 9;
+    unsigned char* wr = evt.evt.midi_message;
+    wr[0] = 0xF0;
+    wr[1] = 0x00;
+    wr[2] = 0x00;
+    wr[3] = 0x66;
+    wr[4] = m_is_mcuex ? 0x15 : 0x14;
+    wr[5] = 0x20;
+    wr[6] = 0x00 + x;
+    wr[7] = 0x03;
+    wr[8] = 0xF7;
+    m_midiout->SendMsg(&evt.evt, -1);
+    m_midiout->Send(0xD0, (x << 4) | 0xF, 0, -1);
+  }
+
+  // Pushes strip x state as REAPER would on full refresh: fader, V-Pot ring,
+  // LEDs and scribble strip. Unchanged values are not sent, see
+  // SetSurfaceState.
+  void UpdateStrip(int x, MediaTrack* t)
+  {
+    m_strip_track[x] = t;
+    m_strip_valid |= 1 << x;
+    m_mcu_meterpos[x] = 0.0;
+    if (!t || t == CSurf_TrackFromID(0, false))
+    {
+      ClearStrip(x);
+      return;
+    }
+
+    double vol = 0.0, pan = 0.0;
+    bool mute = false;
+    GetTrackUIVolPan(t, &vol, &pan);
+    GetTrackUIMute(t, &mute);
+    SetSurfaceVolume(t, vol);
+    SetSurfacePan(t, pan);
+    SetSurfaceMute(t, mute);
+    SetSurfaceSolo(t, GetMediaTrackInfo_Value(t, "I_SOLO") > 0);
+    SetSurfaceSelected(t, IsTrackSelected(t));
+
+    char name[BUFSIZ];
+    name[0] = 0;
+    GetSetMediaTrackInfo_String(t, "P_NAME", name, false);
+    SetTrackTitle(t, name);
+  }
+
+  // Bank change: only strips whose track changed are updated, on all
+  // surfaces, instead of TrackList_UpdateAllExternalSurfaces()
+  static void UpdateBankStrips()
   {
-    if (m_midiout)
+    for (auto mcu : g_mcu_list)
     {
-      int x;
-      for (x = 0; x < 8; x++)
+      if (!mcu || !mcu->m_midiout)
+        continue;
+      for (int x = 0; x < 8; x++)
       {
-        MediaTrack* t = CSurf_TrackFromID(x + GetBankOffset(), g_csurf_mcpmode);
-        if (!t || t == CSurf_TrackFromID(0, false))
-        {
-          // clear item
-          int panint = m_flipmode ? panToInt14(0.0) : volToInt14(0.0);
-          unsigned char volch = m_flipmode ? volToChar(0.0) : panToChar(0.0);
-
-          m_midiout->Send(0xe0 + (x & 0xf), panint & 0x7f, (panint >> 7) & 0x7f,
-                          -1);
-          m_midiout->Send(0xb0, 0x30 + (x & 0xf), 1 + ((volch * 11) >> 7), -1);
-          m_vol_lastpos[x] = panint;
-
-          m_midiout->Send(0x90, 0x10 + (x & 7), 0, -1); // reset mute
-          m_midiout->Send(0x90, 0x18 + (x & 7), 0,
-                          -1); // reset selected
-
-          m_midiout->Send(0x90, 0x08 + (x & 7), 0, -1); // reset solo
-          m_midiout->Send(0x90, 0x0 + (x & 7), 0, -1);  // reset recarm
-
-          char buf[7] = {
-            0,
-          };
-          UpdateMackieDisplay(x * 7, buf, 7); // clear display
-
-          struct
-          {
-            MIDI_event_t evt;
-            char data[9];
-          } evt;
-
-          evt.evt.frame_offset = 0;
-          evt.evt.size = 9;
-          unsigned char* wr = evt.evt.midi_message;
-          wr[0] = 0xF0;
-          wr[1] = 0x00;
-          wr[2] = 0x00;
-          wr[3] = 0x66;
-          wr[4] = m_is_mcuex ? 0x15 : 0x14;
-          wr[5] = 0x20;
-          wr[6] = 0x00 + x;
-          wr[7] = 0x03;
-          wr[8] = 0xF7;
-          Sleep(5);
-          m_midiout->SendMsg(&evt.evt, -1);
-          Sleep(5);
-          m_midiout->Send(0xD0, (x << 4) | 0xF, 0, -1);
-        }
+        MediaTrack* t =
+          CSurf_TrackFromID(x + mcu->GetBankOffset(), g_csurf_mcpmode);
+        if (!(mcu->m_strip_valid & 1 << x) || mcu->m_strip_track[x] != t)
+          mcu->UpdateStrip(x, t);
       }
     }
   }
 
 #define FIXID(id)                                                              \
-  const int oid = CSurf_TrackToID(trackid, g_csurf_mcpmode);                   \
+  const int oid = GetRefreshCache(trackid)->id;                                \
   int id = oid;                                                                \
   if (id > 0)                                                                  \
   {                                                                            \
@@ -1371,6 +2145,9 @@ public:
 
   void SetSurfaceVolume(MediaTrack* trackid, double volume)
   {
+    StatTimer timer(m_stats, STAT_SET_SURFACE);
+    m_trace.AddCallback(timer.GetStart(), TRACE_SET_VOLUME,
+                        GetRefreshCache(trackid)->id, volume);
     if (!m_is_default)
     {
       return;
@@ -1392,7 +2169,7 @@ public:
 
     if (this->m_mode == 2)
     {
-      volume = GetSendLevel(trackid);
+      volume = GetRefreshSend(trackid, REFRESH_SEND_VOL)->send_vol;
     }
 
     if (m_midiout && id >= 0 && id < 256 && id < m_size)
@@ -1401,100 +2178,69 @@ public:
       {
         unsigned char volch = volToChar(volume);
         if (id < 8)
-          m_midiout->Send(0xb0, 0x30 + (id & 0xf), 1 + ((volch * 11) >> 7), -1);
+          SetCC(0x30 + id, 1 + ((volch * 11) >> 7));
       }
-      else
+      else if (id < 16)
       {
-        int volint = volToInt14(volume);
-
-        if (m_vol_lastpos[id] != volint)
-        {
-          m_vol_lastpos[id] = volint;
-          m_midiout->Send(0xe0 + (id & 0xf), volint & 0x7f,
-                          (volint >> 7) & 0x7f, -1);
-        }
+        SetFader(id, volToInt14(volume));
       }
     }
 
     // discrete master
     if (m_midiout && hasMcuMaster && trackid == mcuMaster && !m_flipmode)
     {
-      id = 8;
-      int volint = volToInt14(volume);
-      if (m_vol_lastpos[id] != volint)
-      {
-        m_vol_lastpos[id] = volint;
-        m_midiout->Send(0xe0 + (id & 0xf), volint & 0x7f, (volint >> 7) & 0x7f,
-                        -1);
-      }
+      SetFader(8, volToInt14(volume));
     }
   }
 
-  double GetSendLevel(MediaTrack* src, MediaTrack* dst = GetSelectedTrack(0, 0))
+  double GetSendLevel(MediaTrack* src, MediaTrack* dst = GetSelectedTrackCached())
   {
-    double res{0};
-    if (!dst)
-    {
-      return res;
-    }
-    for (int i = 0; i < GetTrackNumSends(src, 0); i++)
-    {
-      auto tr = (MediaTrack*)(uintptr_t)GetTrackSendInfo_Value(src, 0, i,
-                                                               "P_DESTTRACK");
-      if (tr == dst)
-      {
-        res = GetTrackSendInfo_Value(src, 0, i, "D_VOL");
-        break;
-      }
-    }
-    return res;
+    auto idx = GetSendIndex(src, dst);
+    return idx >= 0 ? GetTrackSendInfo_Value(src, 0, idx, "D_VOL") : 0.0;
   }
 
   void SetSurfacePan(MediaTrack* trackid, double pan)
   {
+    StatTimer timer(m_stats, STAT_SET_SURFACE);
+    m_trace.AddCallback(timer.GetStart(), TRACE_SET_PAN,
+                        GetRefreshCache(trackid)->id, pan);
     if (!m_is_default)
     {
       return;
     }
     if (this->m_mode == 2)
     {
-      auto idx = GetSendIndex(trackid);
-      pan = GetTrackSendInfo_Value(trackid, 0, idx, "D_PAN");
+      pan = GetRefreshSend(trackid, REFRESH_SEND_PAN)->send_pan;
     }
     FIXID(id)
     if (m_midiout && id >= 0 && id < 256 && id < m_size)
     {
-      unsigned char panch = panToChar(pan);
-      if (m_pan_lastpos[id] != panch)
+      if (m_flipmode)
       {
-        m_pan_lastpos[id] = panch;
-
-        if (m_flipmode)
-        {
-          int panint = panToInt14(pan);
-          m_vol_lastpos[id] = panint;
-          m_midiout->Send(0xe0 + (id & 0xf), panint & 0x7f,
-                          (panint >> 7) & 0x7f, -1);
-        }
-        else
-        {
-          if (id < 8)
-            m_midiout->Send(0xb0, 0x30 + (id & 0xf), 1 + ((panch * 11) >> 7),
-                            -1);
-        }
+        if (id < 16)
+          SetFader(id, panToInt14(pan));
+      }
+      else
+      {
+        unsigned char panch = panToChar(pan);
+        if (id < 8)
+          SetCC(0x30 + id, 1 + ((panch * 11) >> 7));
       }
     }
   }
 
   void SetSurfaceMute(MediaTrack* trackid, bool mute)
   {
+    StatTimer timer(m_stats, STAT_SET_SURFACE);
+    m_trace.AddCallback(timer.GetStart(), TRACE_SET_MUTE,
+                        GetRefreshCache(trackid)->id, mute);
     if (!m_is_default)
     {
       return;
     }
     if (m_mode == 2)
     {
-      mute = isSendMuted(trackid, GetSendIndex(trackid));
+      mute = GetRefreshSend(trackid, REFRESH_SEND_MUTE)->send_mute;
     }
 
     FIXID(id)
@@ -1503,13 +2249,17 @@ public:
     {
       if (id < 8)
       {
-        m_midiout->Send(0x90, 0x10 + (id & 7), mute ? 0x7f : 0, -1);
+        SetNote(0x10 + id, mute ? 0x7f : 0);
       }
     }
   }
 
   void SetSurfaceSelected(MediaTrack* trackid, bool selected)
   {
+    StatTimer timer(m_stats, STAT_SET_SURFACE);
+    m_trace.AddCallback(timer.GetStart(), TRACE_SET_SELECTED,
+                        GetRefreshCache(trackid)->id, selected);
+    OnSelectedTrackChange(trackid, selected);
     if (!m_is_default)
     {
       return;
@@ -1519,12 +2269,15 @@ public:
     if (m_midiout && id >= 0 && id < 256 && id < m_size)
     {
       if (id < 8)
-        m_midiout->Send(0x90, 0x18 + (id & 7), selected ? 0x7f : 0, -1);
+        SetNote(0x18 + id, selected ? 0x7f : 0);
     }
   }
 
   void SetSurfaceSolo(MediaTrack* trackid, bool solo)
   {
+    StatTimer timer(m_stats, STAT_SET_SURFACE);
+    m_trace.AddCallback(timer.GetStart(), TRACE_SET_SOLO,
+                        GetRefreshCache(trackid)->id, solo);
     if (!m_is_default)
     {
       return;
@@ -1533,21 +2286,22 @@ public:
     if (m_midiout && id >= 0 && id < 256 && id < m_size)
     {
       if (id < 8)
-        m_midiout->Send(0x90, 0x08 + (id & 7), solo ? 1 : 0,
-                        -1); // blink
+        SetNote(0x08 + id, solo ? 1 : 0); // blink
       else if (id == 8)
       {
         // Hmm, seems to call this with id 8 to tell if any
         // tracks are soloed.
-        m_midiout->Send(0x90, 0x73, solo ? 1 : 0, -1); // rude solo light
-        m_midiout->Send(0x90, 0x5a, solo ? 0x7f : 0,
-                        -1); // solo button led
+        SetNote(0x73, solo ? 1 : 0);    // rude solo light
+        SetNote(0x5a, solo ? 0x7f : 0); // solo button led
       }
     }
   }
 
   void SetSurfaceRecArm(MediaTrack* trackid, bool recarm)
   {
+    StatTimer timer(m_stats, STAT_SET_SURFACE);
+    m_trace.AddCallback(timer.GetStart(), TRACE_SET_RECARM,
+                        GetRefreshCache(trackid)->id, recarm);
     (void)trackid;
     (void)recarm;
     return;
@@ -1562,16 +2316,28 @@ public:
 
   void SetPlayState(bool play, bool pause, bool rec)
   {
+    StatTimer timer(m_stats, STAT_SET_SURFACE);
+    m_trace.AddCallback(timer.GetStart(), TRACE_SET_PLAYSTATE, -1,
+                        play | pause << 1 | rec << 2);
     if (m_midiout && !m_is_mcuex)
     {
-      m_midiout->Send(0x90, 0x5f, rec ? 0x7f : 0, -1);
-      m_midiout->Send(0x90, 0x5e, play || pause ? 0x7f : 0, -1);
-      m_midiout->Send(0x90, 0x5d, !play ? 0x7f : 0, -1);
+      SetNote(0x5f, rec ? 0x7f : 0);
+      SetNote(0x5e, play || pause ? 0x7f : 0);
+      SetNote(0x5d, !play ? 0x7f : 0);
     }
   }
 
   void SetTrackTitle(MediaTrack* trackid, const char* title)
   {
+    StatTimer timer(m_stats, STAT_SET_SURFACE);
+    m_trace.AddCallback(timer.GetStart(), TRACE_SET_TRACKTITLE,
+                        GetRefreshCache(trackid)->id, 0);
+    // renamed to output track name
+    if (title && GetOutputTrack() == GetMasterTrack(0) &&
+        IsOutputTrackName(title))
+    {
+      InvalidateOutputTrack();
+    }
     if (!m_is_default)
     {
       return;
@@ -1632,8 +2398,8 @@ public:
 
   void ResetCachedVolPanStates()
   {
-    memset(m_vol_lastpos, 0xff, sizeof(m_vol_lastpos));
-    memset(m_pan_lastpos, 0xff, sizeof(m_pan_lastpos));
+    InvalidateSurfaceState(0xe0, 0, 15);
+    InvalidateSurfaceState(0xb0, 0x30, 0x37);
   }
 
   bool OnBankChannel(MIDI_event_t* evt)
@@ -1717,31 +2483,29 @@ public:
         if (mcu->m_page != 8)
         {
           // not 0 .. 7
-          mcu->m_midiout->Send(0x90, 0x0 + (mcu->m_page & 7), 0,
-                               -1); // 0x7f : 0
+          mcu->SetNote(0x0 + (mcu->m_page & 7), 0); // 0x7f : 0
           mcu->m_page = 8;
         }
         if (device == n)
         {
           mcu->m_page = newPage;
-          mcu->m_midiout->Send(0x90, 0x0 + (m_page & 7), 0x7f,
-                               -1); // 0x7f : 0
+          mcu->SetNote(0x0 + (m_page & 7), 0x7f); // 0x7f : 0
         }
       }
       if (mcu && !mcu->m_is_mcuex && mcu->m_midiout)
       {
-        mcu->m_midiout->Send(0xB0, 0x40 + 11, '0' + (((*offset + 1) / 10) % 10),
-                             -1);
-        mcu->m_midiout->Send(0xB0, 0x40 + 10, '0' + ((*offset + 1) % 10), -1);
+        mcu->SetCC(0x40 + 11, '0' + (((*offset + 1) / 10) % 10));
+        mcu->SetCC(0x40 + 10, '0' + ((*offset + 1) % 10));
       }
       n++;
     }
-    TrackList_UpdateAllExternalSurfaces();
+    UpdateBankStrips();
     return true;
   }
 
   void OnTrackSelection(MediaTrack* trackid)
   {
+    OnSelectedTrackChange(trackid, true);
     if (!m_is_default)
     {
       return;
@@ -1774,7 +2538,7 @@ public:
         g_allmcus_bank_offset = no;
         // update all of the sliders
 
-        TrackList_UpdateAllExternalSurfaces();
+        UpdateBankStrips();
         n = 0;
         for (auto mcu : g_mcu_list)
         {
@@ -1785,22 +2549,18 @@ public:
           n++;
           if (mcu && mcu->m_midiout)
           {
-            mcu->m_midiout->Send(0x90, 0x0 + (mcu->m_page & 7), 0,
-                                 -1); // 0x7f : 0
+            mcu->SetNote(0x0 + (mcu->m_page & 7), 0); // 0x7f : 0
             if (mcu == this)
             {
               mcu->m_page = (tid - 1) / movesize;
-              mcu->m_midiout->Send(0x90, 0x0 + (mcu->m_page & 7), 0x7f,
-                                   -1); // 0x7f : 0
+              mcu->SetNote(0x0 + (mcu->m_page & 7), 0x7f); // 0x7f : 0
             }
           }
           if (mcu && !mcu->m_is_mcuex && mcu->m_midiout)
           {
-            mcu->m_midiout->Send(
-              0xB0, 0x40 + 11, '0' + (((g_allmcus_bank_offset + 1) / 10) % 10),
-              -1);
-            mcu->m_midiout->Send(0xB0, 0x40 + 10,
-                                 '0' + ((g_allmcus_bank_offset + 1) % 10), -1);
+            mcu->SetCC(0x40 + 11,
+                       '0' + (((g_allmcus_bank_offset + 1) / 10) % 10));
+            mcu->SetCC(0x40 + 10, '0' + ((g_allmcus_bank_offset + 1) % 10));
           }
         }
       }
@@ -1849,7 +2609,7 @@ public:
       *offset = no;
 
       // update all of the sliders
-      TrackList_UpdateAllExternalSurfaces();
+      UpdateBankStrips();
 
       for (auto mcu : g_mcu_list)
       {
@@ -1862,22 +2622,19 @@ public:
           if (mcu->m_page != 8)
           {
             // not 0 .. 7
-            mcu->m_midiout->Send(0x90, 0x0 + (mcu->m_page & 7), 0,
-                                 -1); // 0x7f : 0
+            mcu->SetNote(0x0 + (mcu->m_page & 7), 0); // 0x7f : 0
             mcu->m_page = 8;
           }
           if (mcu == this)
           {
             mcu->m_page = tid;
-            mcu->m_midiout->Send(0x90, 0x0 + (tid & 7), 0x7f,
-                                 -1); // 0x7f : 0
+            mcu->SetNote(0x0 + (tid & 7), 0x7f); // 0x7f : 0
           }
         }
         if (mcu && !mcu->m_is_mcuex && mcu->m_midiout)
         {
-          mcu->m_midiout->Send(0xB0, 0x40 + 11,
-                               '0' + (((*offset + 1) / 10) % 10), -1);
-          mcu->m_midiout->Send(0xB0, 0x40 + 10, '0' + ((*offset + 1) % 10), -1);
+          mcu->SetCC(0x40 + 11, '0' + (((*offset + 1) / 10) % 10));
+          mcu->SetCC(0x40 + 10, '0' + ((*offset + 1) % 10));
         }
       }
     }
@@ -1890,12 +2647,13 @@ public:
     if ((call == CSURF_EXT_SETSENDVOLUME || call == CSURF_EXT_SETSENDPAN) &&
         m_mode == 2)
     {
+      InvalidateRefreshCache();
       auto trackid = (MediaTrack*)parm1;
       auto sendIdx = *(int*)parm2;
       auto val = *(double*)parm3;
       auto dst = (MediaTrack*)(uintptr_t)GetTrackSendInfo_Value(
         trackid, 0, sendIdx, "P_DESTTRACK");
-      if (dst != GetSelectedTrack(0, 0))
+      if (dst != GetSelectedTrackCached())
       {
         return 0;
       }
@@ -2085,30 +2843,20 @@ void CSurf_MCULive::RunOutput(double now)
     if (m_mackie_lasttime_mode != tmode)
     {
       m_mackie_lasttime_mode = tmode;
-      m_midiout->Send(0x90, 0x71, tmode == 5 ? 0x7F : 0,
-                      -1); // set smpte light
-      m_midiout->Send(0x90, 0x72,
-                      m_mackie_lasttime_mode > 0 && tmode < 3 ? 0x7F : 0,
-                      -1); // set beats light
+      SetNote(0x71, tmode == 5 ? 0x7F : 0); // set smpte light
+      SetNote(0x72, m_mackie_lasttime_mode > 0 && tmode < 3 ? 0x7F
+                                                            : 0); // set beats light
     }
 
     {
-      bool force = false;
       if (now > m_mcu_timedisp_lastforce)
       {
         m_mcu_timedisp_lastforce = now + 2000;
-        force = true;
+        InvalidateSurfaceState(0xb0, 0x40, 0x40 + (int)sizeof(bla) - 1);
       }
       int x;
       for (x = 0; x < sizeof(bla); x++)
-      {
-        int idx = sizeof(bla) - x - 1;
-        if (bla[idx] != m_mackie_lasttime[idx] || force)
-        {
-          m_midiout->Send(0xB0, 0x40 + x, bla[idx], -1);
-          m_mackie_lasttime[idx] = bla[idx];
-        }
-      }
+        SetCC(0x40 + x, bla[sizeof(bla) - x - 1]);
     }
 
     if (__g_projectconfig_metronome_en)
@@ -2119,48 +2867,7 @@ void CSurf_MCULive::RunOutput(double now)
       if ((m_last_miscstate & 1) != lmp)
       {
         m_last_miscstate = (m_last_miscstate & ~1) | lmp;
-        m_midiout->Send(0x90, 0x59, lmp ? 0x7f : 0,
-                        -1); // click (metronome) indicator
-      }
-    }
-  }
-
-  {
-    int x;
-#define VU_BOTTOM 70
-    double decay = 0.0;
-    if (m_mcu_meter_lastrun)
-    {
-      decay = VU_BOTTOM * (double)(now - m_mcu_meter_lastrun) /
-              (1.4); // they claim 1.8s for falloff but we'll
-                     // underestimate
-    }
-    m_mcu_meter_lastrun = now;
-    for (x = 0; x < 8; x++)
-    {
-      int idx = GetBankOffset() + x;
-      MediaTrack* t;
-      if ((t = CSurf_TrackFromID(idx, g_csurf_mcpmode)))
-      {
-        double pp =
-          VAL2DB((Track_GetPeakInfo(t, 0) + Track_GetPeakInfo(t, 1)) * 0.5);
-
-        if (m_mcu_meterpos[x] > -VU_BOTTOM * 2)
-          m_mcu_meterpos[x] -= decay;
-
-        if (pp < m_mcu_meterpos[x])
-          continue;
-        m_mcu_meterpos[x] = pp;
-        int v = 0xd; // 0xe turns on clip indicator, 0xf turns it off
-        if (pp < 0.0)
-        {
-          if (pp < -VU_BOTTOM)
-            v = 0x0;
-          else
-            v = (int)((pp + VU_BOTTOM) * 13.0 / VU_BOTTOM);
-        }
-
-        m_midiout->Send(0xD0, (x << 4) | v, 0, -1);
+        SetNote(0x59, lmp ? 0x7f : 0); // click (metronome) indicator
       }
     }
   }
@@ -2177,6 +2884,8 @@ static IReaperControlSurface* createFunc(const char* type_string,
   if (!init)
   {
     init = true;
+    InitMeterThresholds();
+    InitVolumeTables();
   }
 
   return new CSurf_MCULive(!strcmp(type_string, "MCULIVEEX"), parms[0],
@@ -2412,6 +3121,7 @@ int Map(int device, int button, int command_id, bool isRemap)
   {
     g_mcu_list[device]->m_button_map[button] = command_id;
   }
+  g_mcu_list[device]->BuildButtonRoutes();
   return button;
 }
 
@@ -2429,6 +3139,7 @@ int SetButtonPressOnly(int device, int button, bool isSet)
     return -1;
   }
   g_mcu_list[device]->m_press_only_buttons[button] = isSet ? 1 : 0;
+  g_mcu_list[device]->BuildButtonRoutes();
   return button;
 }
 
@@ -2444,6 +3155,7 @@ int SetButtonPassthrough(int device, int button, bool isSet)
     return -1;
   }
   g_mcu_list[device]->m_buttons_passthrough[button] = isSet ? 1 : 0;
+  g_mcu_list[device]->BuildButtonRoutes();
   return button;
 }
 
@@ -2481,11 +3193,15 @@ const char* defstring_SetOption =
   "void\0int,int\0"
   "option,value\0"
   "1 : surface split point device index \n"
-  "2 : 'mode-is-global' bitmask/flags, first 6 bits";
+  "2 : 'mode-is-global' bitmask/flags, first 6 bits \n"
+  "3 : measure MIDI output enqueue-to-wire latency, 0 = off, 1 = on (resets "
+  "measurements). See MCULive_GetDevice. \n"
+  "4 : print MCULive_GetStats of all devices to ReaScript console every "
+  "value seconds, 0 = off (default).";
 
 void SetOption(int option, int value)
 {
-  if (option > 2 || option < 1)
+  if (option > 4 || option < 1)
   {
     return;
   }
@@ -2497,10 +3213,105 @@ void SetOption(int option, int value)
   {
     g_mode_is_global = value & ((1 << 8) - 1);
   }
+  if (option == 3)
+  {
+    SetThreadedMIDIOutputLatencyMode(value != 0);
+  }
+  if (option == 4)
+  {
+    g_stats_dump_interval = value > 0 ? value : 0;
+    g_stats_dump_lastrun = time_precise();
+  }
 
   return;
 }
 
+static const char* defstring_SetDeviceOption =
+  "int\0int,int,int\0"
+  "device,option,value\0"
+  "Set per device option. Returns value or -1 on error. \n"
+  "1 : MIDI output budget in bytes per second, 0 = unlimited (default). "
+  "E.g. 3125 for 5-pin DIN MIDI. Short messages (faders, LEDs) are sent "
+  "before queued SysEx (LCD). \n"
+  "2 : minimum gap between output SysEx messages in milliseconds, default "
+  "5. \n"
+  "3 : MIDI output coalescing, 1 = on (default), 0 = off. Queued note, CC, "
+  "pitch bend and channel pressure messages are replaced by newer values for "
+  "the same target. Turn off for devices needing every message, e.g. note "
+  "on/off pairs. \n"
+  "4 : input queue capacity in messages, default 256, max 65536. Clears "
+  "queue. \n"
+  "5 : input queue overflow policy, 0 = drop oldest (default), 1 = drop "
+  "newest, 2 = coalesce, queued pitch bend (fader) or channel pressure "
+  "message takes newer value for the same target, else drop oldest. \n"
+  "6 : built-in input coalescing, 1 = on, 0 = off (default). Fader moves "
+  "and V-Pot turns are handled once per strip per update cycle, with last "
+  "fader value and summed V-Pot turns. Order of other messages is kept. "
+  "Script input queue is not affected. \n"
+  "7 : MIDI input thread, 1 = on, 0 = off (default). Input is read "
+  "continuously instead of at control surface rate. Fader touch is "
+  "tracked right away, and with default operation off fader moves are "
+  "echoed back right away (fader touch mode respected). Messages keep "
+  "their timing in frame_offset. \n"
+  "8 : VU meter update rate in Hz, 0 = control surface rate (default). "
+  "Unchanged meter segments are resent only every 250 ms. \n"
+  "9 : output capture, 1 = on, 0 = off (default). Outgoing messages are "
+  "copied for MCULive_GetOutputMessages. Device without MIDI output gets "
+  "virtual output, so it can be driven with MCULive_InjectMIDIMessage "
+  "alone. Clears capture.";
+
+static int SetDeviceOption(int device, int option, int value)
+{
+  if (device < 0 || device >= (int)g_mcu_list.size() || value < 0)
+  {
+    return -1;
+  }
+  auto output = g_mcu_list[device]->m_midiout;
+  if (option == 1)
+  {
+    SetThreadedMIDIOutputPacing(output, (double)value, -1.0);
+    return value;
+  }
+  if (option == 2)
+  {
+    SetThreadedMIDIOutputPacing(output, -1.0, value * 0.001);
+    return value;
+  }
+  if (option == 3)
+  {
+    SetThreadedMIDIOutputCoalescing(output, value != 0);
+    return value;
+  }
+  if (option == 4)
+  {
+    return g_mcu_list[device]->midiBuffer.SetCapacity(value) ? value : -1;
+  }
+  if (option == 5)
+  {
+    return g_mcu_list[device]->midiBuffer.SetPolicy(value) ? value : -1;
+  }
+  if (option == 6)
+  {
+    g_mcu_list[device]->m_input_coalesce = value != 0;
+    return value;
+  }
+  if (option == 7)
+  {
+    return g_mcu_list[device]->SetInputThread(value != 0) ? value : -1;
+  }
+  if (option == 8)
+  {
+    g_mcu_list[device]->m_meter_rate = value;
+    return value;
+  }
+  if (option == 9)
+  {
+    g_mcu_list[device]->SetCapture(value != 0);
+    return value;
+  }
+  return -1;
+}
+
 static const char* defstring_GetButtonValue = "int\0int,int\0"
                                               "device,button\0"
                                               "Get current button state.";
@@ -2530,7 +3341,7 @@ static int SetButtonValue(int device, int button, int value)
   if (!g_mcu_list[device]->m_midiout)
     return -1;
 
-  g_mcu_list[device]->m_midiout->Send(0x90, button, value, -1);
+  g_mcu_list[device]->SetNote(button, value);
   return value;
 }
 
@@ -2587,6 +3398,72 @@ static double GetEncoderValue(int device, int encIdx, int param)
   return -1;
 }
 
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_FADERS 9
+#define SNAPSHOT_ENCODERS 8
+#define SNAPSHOT_BUTTONS 256
+#define SNAPSHOT_SIZE                                                          \
+  (4 + 8 + SNAPSHOT_FADERS * (4 + 8 + 1) + SNAPSHOT_ENCODERS * (4 + 8) +     \
+   SNAPSHOT_BUTTONS)
+
+static const char* defstring_GetSurfaceSnapshot =
+  "int\0int,char*,int\0"
+  "device,snapshotOutNeedBig,snapshotOutNeedBig_sz\0"
+  "Gets whole input state of device in one call as packed little-endian "
+  "binary string: int32 version (1), double lastmove (any fader), "
+  "9 x int32 fader lastpos, 9 x double fader lasttouch, 9 x uint8 fader "
+  "touch state, 8 x int32 encoder lastpos, 8 x double encoder lasttouch, "
+  "256 x uint8 button state. Lua: string.unpack(\"<i4d\" .. "
+  "(\"i4\"):rep(9) .. (\"d\"):rep(9) .. (\"B\"):rep(9) .. (\"i4\"):rep(8) "
+  ".. (\"d\"):rep(8) .. (\"B\"):rep(256), snapshot). "
+  "Returns snapshot size or -1.";
+
+static int GetSurfaceSnapshot(int device, char* snapshotOutNeedBig,
+                              int snapshotOutNeedBig_sz)
+{
+  if (device < 0 || device >= (int)g_mcu_list.size())
+  {
+    return -1;
+  }
+  char* buf = snapshotOutNeedBig;
+  if (snapshotOutNeedBig_sz != SNAPSHOT_SIZE &&
+      !realloc_cmd_ptr(&buf, &snapshotOutNeedBig_sz, SNAPSHOT_SIZE))
+  {
+    return -1;
+  }
+
+  auto mcu = g_mcu_list[device];
+  char* wr = buf;
+  auto put = [&wr](const void* p, size_t n) {
+    memcpy(wr, p, n);
+    wr += n;
+  };
+  int32_t i32 = SNAPSHOT_VERSION;
+  put(&i32, 4);
+  put(&mcu->m_fader_lastmove, 8);
+  for (int x = 0; x < SNAPSHOT_FADERS; x++)
+  {
+    i32 = mcu->m_fader_pos[x];
+    put(&i32, 4);
+  }
+  put(mcu->m_fader_lasttouch, SNAPSHOT_FADERS * 8);
+  for (int x = 0; x < SNAPSHOT_FADERS; x++)
+  {
+    *wr++ = mcu->m_fader_touchstate[x].load(std::memory_order_relaxed);
+  }
+  for (int x = 0; x < SNAPSHOT_ENCODERS; x++)
+  {
+    i32 = mcu->m_encoder_pos[x];
+    put(&i32, 4);
+  }
+  put(mcu->m_pan_lasttouch, SNAPSHOT_ENCODERS * 8);
+  for (int x = 0; x < SNAPSHOT_BUTTONS; x++)
+  {
+    *wr++ = (char)mcu->m_button_states[x];
+  }
+  return SNAPSHOT_SIZE;
+}
+
 static const char* defstring_SetFaderValue =
   "int\0int,int,double,int\0"
   "device,faderIdx,val,type\0"
@@ -2620,8 +3497,7 @@ static int SetFaderValue(int device, int faderIdx, double val, int type)
     return -1;
   }
 
-  g_mcu_list[device]->m_midiout->Send(0xe0 + (faderIdx & 0xf), newVal & 0x7f,
-                                      (newVal >> 7) & 0x7f, -1);
+  g_mcu_list[device]->SetFader(faderIdx, newVal);
   return newVal;
 }
 
@@ -2659,8 +3535,7 @@ static int SetEncoderValue(int device, int encIdx, double val, int type)
   }
 
   if (encIdx < 8)
-    g_mcu_list[device]->m_midiout->Send(0xb0, 0x30 + (encIdx & 0xf),
-                                        1 + ((newVal * 11) >> 7), -1);
+    g_mcu_list[device]->SetCC(0x30 + encIdx, 1 + ((newVal * 11) >> 7));
   return newVal;
 }
 
@@ -2668,7 +3543,7 @@ static const char* defstring_SetMeterValue =
   "int\0int,int,double,int\0"
   "device,meterIdx,val,type\0"
   "Set meter value 0 ... 1.0. Type 0 = linear, 1 = track "
-  "volume (with decay).";
+  "volume (with decay, meterIdx 0 ... 7).";
 
 static int SetMeterValue(int device, int meterIdx, double val, int type)
 {
@@ -2677,46 +3552,29 @@ static int SetMeterValue(int device, int meterIdx, double val, int type)
   {
     return -1;
   }
-  if (!g_mcu_list[device]->m_midiout)
+  auto mcu = g_mcu_list[device];
+  if (!mcu->m_midiout)
     return -1;
-  // double pp =
-  //     VAL2DB((Track_GetPeakInfo(t, 0) + Track_GetPeakInfo(t, 1)) * 0.5);
 
   int v{0};
-  auto pp = val;
-  auto now = time_precise();
-  g_mcu_list[device]->m_mcu_meter_lastrun = now;
   if (type == 1)
   {
-    auto decay = 0.0;
-    pp = VAL2DB(val);
-    if (g_mcu_list[device]->m_mcu_meter_lastrun)
-    {
-      decay = VU_BOTTOM *
-              (double)(now - g_mcu_list[device]->m_mcu_meter_lastrun) /
-              (1.4); // * 1000.0); // they claim 1.8s for falloff but
-                     // we'll underestimate
-    }
-    if (g_mcu_list[device]->m_mcu_meterpos[meterIdx] > -VU_BOTTOM * 2)
-      g_mcu_list[device]->m_mcu_meterpos[meterIdx] -= decay;
-    if (pp < g_mcu_list[device]->m_mcu_meterpos[meterIdx])
-      pp = g_mcu_list[device]->m_mcu_meterpos[meterIdx];
-    g_mcu_list[device]->m_mcu_meterpos[meterIdx] = pp;
-    v = 0xd; // 0xe turns on clip indicator, 0xf turns it off
-    if (pp < 0.0)
-    {
-      if (pp < -VU_BOTTOM)
-        v = 0x0;
-      else
-        v = (int)((pp + VU_BOTTOM) * 13.0 / VU_BOTTOM);
-    }
+    if (meterIdx >= 8)
+      return -1;
+    auto now = time_precise();
+    // held value is shown, device keeps it lit while resent
+    mcu->m_mcu_meter_sent[meterIdx] = -1;
+    mcu->UpdateMeter(
+      meterIdx, val, now,
+      GetMeterDecay(now - mcu->m_mcu_meter_falltime[meterIdx]));
+    v = GetMeterSegment(mcu->m_mcu_meterpos[meterIdx]);
   }
   else
   {
     v = (int)(val * 16);
   }
 
-  g_mcu_list[device]->m_midiout->Send(0xD0, (meterIdx << 4) | v, 0, -1);
+  mcu->m_midiout->Send(0xD0, (meterIdx << 4) | v, 0, -1);
   return v;
 }
 
@@ -2747,11 +3605,15 @@ static const char* defstring_GetDevice =
   "int\0int,int\0"
   "device,type\0"
   "Get MIDI input or output dev ID. type 0 is input dev, type 1 is output "
-  "dev. device < 0 returns number of MCULive devices.";
+  "dev, type 2 is number of output messages dropped due to full output "
+  "queue, type 3 is average and type 4 maximum output latency in "
+  "microseconds (see MCULive_SetOption), type 5 is number of input "
+  "messages dropped and type 6 coalesced due to full input queue (see "
+  "MCULive_SetDeviceOption). device < 0 returns number of MCULive devices.";
 
 static int GetDevice(int device, int type)
 {
-  if (device >= (int)g_mcu_list.size() || type < 0 || type >= 1)
+  if (device >= (int)g_mcu_list.size() || type < 0 || type > 6)
   {
     return -1;
   }
@@ -2759,6 +3621,14 @@ static int GetDevice(int device, int type)
   {
     return (int)g_mcu_list.size();
   }
+  if (type == 5)
+  {
+    return (int)g_mcu_list[device]->midiBuffer.GetDropped();
+  }
+  if (type == 6)
+  {
+    return (int)g_mcu_list[device]->midiBuffer.GetCoalesced();
+  }
   if (type == 0)
   {
     return g_mcu_list[device]->m_midi_in_dev;
@@ -2767,9 +3637,111 @@ static int GetDevice(int device, int type)
   {
     return g_mcu_list[device]->m_midi_out_dev;
   }
+  if (type >= 2)
+  {
+    MIDIOutputStats stats{};
+    if (!GetThreadedMIDIOutputStats(g_mcu_list[device]->m_midiout, &stats))
+    {
+      return 0;
+    }
+    if (type == 2)
+    {
+      return (int)stats.dropped;
+    }
+    if (type == 3)
+    {
+      return (int)(stats.latency_avg * 1000000.0);
+    }
+    return (int)(stats.latency_max * 1000000.0);
+  }
   return -1;
 }
 
+static const char* defstring_GetStats =
+  "int\0int,bool,char*,int\0"
+  "device,reset,statsOutNeedBig,statsOutNeedBig_sz\0"
+  "Gets device counters and timings as one line JSON: input messages, "
+  "input queue high-water mark and drops, output messages and bytes "
+  "queued (out) and on wire (out_sent), output drops, coalesced, queue "
+  "depth and high-water mark, and per stage (run, run_output, "
+  "run_meters, input, set_surface) count, total and max time in "
+  "microseconds with histogram of < 10, 30, 100, 300 us, 1, 3, 10 ms "
+  "and longer. reset clears input and stage counters after reading, "
+  "output counters are kept. Returns 0 or -1.";
+
+static int GetStats(int device, bool reset, char* statsOutNeedBig,
+                    int statsOutNeedBig_sz)
+{
+  if (device >= (int)g_mcu_list.size() || device < 0)
+  {
+    return -1;
+  }
+  WDL_String str;
+  g_mcu_list[device]->FormatStats(&str);
+  if (reset)
+  {
+    g_mcu_list[device]->m_stats = DeviceStats{};
+  }
+  int sz = str.GetLength() + 1;
+  char* res = statsOutNeedBig;
+  if (statsOutNeedBig_sz != sz &&
+      !realloc_cmd_ptr(&res, &statsOutNeedBig_sz, sz))
+  {
+    return -1;
+  }
+  memcpy(res, str.Get(), sz);
+  return 0;
+}
+
+static const char* defstring_DumpTrace =
+  "int\0int,const char*\0"
+  "device,filename\0"
+  "Writes device trace to binary file: last 4096 MIDI messages in and out "
+  "and REAPER callbacks (SetSurfaceVolume etc.) with time_precise() "
+  "timestamps. Tracing is always on. File is 8 byte \"MCUTRACE\", int32 "
+  "version, record size and count, then little-endian records of double "
+  "time, uint8 type, uint8 reserved, uint16 size, 4 message bytes, int32 "
+  "track and float value. Types 1 = in, 2 = out, 16 ... 24 = volume, pan, "
+  "mute, selected, solo, rec arm, play state, track title, track list "
+  "change. Returns number of records or -1.";
+
+static int DumpTrace(int device, const char* filename)
+{
+  if (device >= (int)g_mcu_list.size() || device < 0 || !filename)
+  {
+    return -1;
+  }
+  FILE* fp = fopen(filename, "wb");
+  if (!fp)
+  {
+    return -1;
+  }
+  int n = g_mcu_list[device]->m_trace.Write(fp);
+  if (fclose(fp))
+  {
+    return -1;
+  }
+  return n;
+}
+
+static const char* defstring_ReplayTrace =
+  "int\0int,const char*\0"
+  "device,filename\0"
+  "Replays input messages of file written by MCULive_DumpTrace to device "
+  "with original timing, as with MCULive_InjectMIDIMessage. Works also "
+  "without MIDI devices, see MCULive_SetDeviceOption option 9 for "
+  "capturing output. SysEx is not replayed. Empty filename stops replay. "
+  "Returns number of messages to replay or -1.";
+
+static int ReplayTrace(int device, const char* filename)
+{
+  if (device >= (int)g_mcu_list.size() || device < 0)
+  {
+    return -1;
+  }
+  return g_mcu_list[device]->ReplayTrace(filename);
+}
+
 static const char* defstring_GetMIDIMessage =
   "int\0int,int,int*,int*,int*,int*,char*,int\0"
   "device,msgIdx,statusOut,data1Out,data2Out,frame_offsetOut,msgOutOptional,"
@@ -2791,40 +3763,252 @@ static int GetMIDIMessage(int device, int msgIdx, int* statusOut, int* data1Out,
   {
     return -1;
   }
-  if (g_mcu_list[device]->midiBuffer.empty())
+  auto& queue = g_mcu_list[device]->midiBuffer;
+  if (queue.IsEmpty())
   {
     return 0;
   }
 
-  if (msgIdx > (int)g_mcu_list[device]->midiBuffer.size())
+  if (msgIdx >= queue.GetSize() || msgIdx < -1)
   {
     return -1;
   }
 
   if (msgIdx == -1)
   {
-    return (int)g_mcu_list[device]->midiBuffer.size();
+    return queue.GetSize();
   }
 
-  auto n = g_mcu_list[device]->midiBuffer[msgIdx].size;
+  int n, frame_offset;
+  auto msg = queue.Get(msgIdx, &n, &frame_offset);
   if (n > 3 && n < msgOutOptional_sz)
   {
-    memcpy(msgOutOptional, g_mcu_list[device]->midiBuffer[msgIdx].midi_message,
-           n);
+    memcpy(msgOutOptional, msg, n);
   }
   else if (n < 3)
   {
     return -1;
   }
 
-  *statusOut = g_mcu_list[device]->midiBuffer[msgIdx].midi_message[0];
-  *data1Out = g_mcu_list[device]->midiBuffer[msgIdx].midi_message[1];
-  *data2Out = g_mcu_list[device]->midiBuffer[msgIdx].midi_message[2];
-  *frame_offsetOut = g_mcu_list[device]->midiBuffer[msgIdx].frame_offset;
+  *statusOut = msg[0];
+  *data1Out = msg[1];
+  *data2Out = msg[2];
+  *frame_offsetOut = frame_offset;
+
+  queue.Remove(msgIdx);
+  return queue.GetSize();
+}
+
+static const char* defstring_GetMIDIMessages =
+  "int\0int,char*,int\0"
+  "device,bufOutNeedBig,bufOutNeedBig_sz\0"
+  "Gets (pops) all messages from input buffer/queue in one call, as "
+  "packed little-endian records of int32 frame_offset, int32 length and "
+  "message bytes. Read with Lua: "
+  "frame_offset, msg, pos = string.unpack(\"<i4s4\", buf, pos). "
+  "Linear in number of messages, unlike repeated MCULive_GetMIDIMessage. "
+  "Returns number of messages or -1.";
+
+// drains queue into packed "<i4s4" records, returns number of messages
+static int DrainMIDIMessages(MIDIInputQueue& queue, char* bufOutNeedBig,
+                             int bufOutNeedBig_sz)
+{
+  if (queue.IsEmpty())
+  {
+    return 0;
+  }
+
+  const int n = queue.GetSize();
+  int sz = 0;
+  int len, frame_offset;
+  for (int i = 0; i < n; i++)
+  {
+    queue.Get(i, &len, &frame_offset);
+    sz += 8 + len;
+  }
+  char* buf = bufOutNeedBig;
+  if (bufOutNeedBig_sz != sz && !realloc_cmd_ptr(&buf, &bufOutNeedBig_sz, sz))
+  {
+    return -1;
+  }
+
+  char* wr = buf;
+  for (int i = 0; i < n; i++)
+  {
+    auto msg = queue.Get(i, &len, &frame_offset);
+    int32_t hdr[2] = {frame_offset, len};
+    memcpy(wr, hdr, sizeof(hdr));
+    memcpy(wr + sizeof(hdr), msg, len);
+    wr += sizeof(hdr) + len;
+  }
+
+  queue.Clear();
+  return n;
+}
+
+static int GetMIDIMessages(int device, char* bufOutNeedBig,
+                           int bufOutNeedBig_sz)
+{
+  if (device >= (int)g_mcu_list.size() || device < 0)
+  {
+    return -1;
+  }
+  return DrainMIDIMessages(g_mcu_list[device]->midiBuffer, bufOutNeedBig,
+                           bufOutNeedBig_sz);
+}
+
+static const char* defstring_GetOutputMessages =
+  "int\0int,char*,int\0"
+  "device,bufOutNeedBig,bufOutNeedBig_sz\0"
+  "Gets (pops) all captured output messages in one call, same format as "
+  "MCULive_GetMIDIMessages. Capture is enabled with MCULive_SetDeviceOption "
+  "option 9. Messages are as sent by MCULive, before output coalescing. "
+  "Returns number of messages or -1.";
+
+static int GetOutputMessages(int device, char* bufOutNeedBig,
+                             int bufOutNeedBig_sz)
+{
+  if (device >= (int)g_mcu_list.size() || device < 0 ||
+      !g_mcu_list[device]->m_capture_enabled)
+  {
+    return -1;
+  }
+  return DrainMIDIMessages(g_mcu_list[device]->m_capture, bufOutNeedBig,
+                           bufOutNeedBig_sz);
+}
+
+static const char* defstring_InjectMIDIMessage =
+  "int\0int,int,int,int,int\0"
+  "device,status,data1,data2,frame_offset\0"
+  "Queues MIDI message as if received from device input. Handled on next "
+  "control surface update, also when device has no MIDI input, and shows "
+  "up in MCULive_GetMIDIMessage(s). E.g. replay recorded "
+  "MCULive_GetMIDIMessages stream with output capture (see "
+  "MCULive_SetDeviceOption) to test surface without hardware. Returns "
+  "number of queued messages or -1.";
+
+static int InjectMIDIMessage(int device, int status, int data1, int data2,
+                             int frame_offset)
+{
+  if (device >= (int)g_mcu_list.size() || device < 0 || status < 0x80 ||
+      status >= 0xf0 || data1 < 0 || data1 > 0x7f || data2 < 0 ||
+      data2 > 0x7f)
+  {
+    return -1;
+  }
+  auto& queue = g_mcu_list[device]->m_inject;
+  MIDI_event_t evt = {frame_offset, 3,
+                      {(unsigned char)status, (unsigned char)data1,
+                       (unsigned char)data2}};
+  if ((status & 0xf0) == 0xc0 || (status & 0xf0) == 0xd0)
+    evt.size = 2;
+  queue.Push(&evt);
+  return queue.GetSize();
+}
+
+static const char* defstring_Benchmark =
+  "int\0int,int,char*,int\0"
+  "scenario,iterations,resultOutNeedBig,resultOutNeedBig_sz\0"
+  "Runs surface scenario on current project and all MCULive devices, "
+  "returns one line JSON result with wall time and MIDI messages/bytes "
+  "queued to outputs. Scenario 0 = full refresh "
+  "(TrackList_UpdateAllExternalSurfaces), 1 = bank right and back, 2 = "
+  "mode switch (Pan/Surround and back to previous mode), 3 = rec arm first "
+  "strip on and off. Scenarios 1 ... 3 press buttons of first device. "
+  "Iterations of 1 ... 3 are pairs, so project and surface state is kept. "
+  "Returns -1 on error.";
+
+static int Benchmark(int scenario, int iterations, char* resultOutNeedBig,
+                     int resultOutNeedBig_sz)
+{
+  static const char* names[] = {"refresh", "bank", "mode", "recarm"};
+  if (scenario < 0 || scenario > 3 || iterations < 1 || g_mcu_list.empty())
+  {
+    return -1;
+  }
+  auto mcu = g_mcu_list[0];
+  if (scenario == 3 && !mcu->m_is_default)
+  {
+    return -1;
+  }
+
+  unsigned int msgs0{0}, bytes0{0};
+  for (auto item : g_mcu_list)
+  {
+    MIDIOutputStats stats{};
+    if (GetThreadedMIDIOutputStats(item->m_midiout, &stats))
+    {
+      msgs0 += stats.enqueued;
+      bytes0 += stats.enqueued_bytes;
+    }
+  }
+
+  // mode button to return to, m_mode is 1-based, 0 before first mode set
+  int mode0 = mcu->m_mode > 0 ? mcu->m_mode - 1 : 0;
+
+  MIDI_event_t evt = {0, 3, {0x90, 0, 0x7f}};
+  double total{0}, tmax{0};
+  for (int i = 0; i < iterations; i++)
+  {
+    double t0 = time_precise();
+    switch (scenario)
+    {
+    case 0:
+      TrackList_UpdateAllExternalSurfaces();
+      break;
+    case 1:
+      evt.midi_message[1] = 0x2f; // bank right
+      mcu->OnBankChannel(&evt);
+      evt.midi_message[1] = 0x2e;
+      mcu->OnBankChannel(&evt);
+      break;
+    case 2:
+      evt.midi_message[1] = 0x2a; // pan/surround
+      mcu->OnModeSet(&evt);
+      evt.midi_message[1] = (unsigned char)(0x28 + mode0);
+      mcu->OnModeSet(&evt);
+      break;
+    case 3:
+      evt.midi_message[1] = 0x00; // rec arm strip 1
+      mcu->OnRecArm(&evt);
+      mcu->OnRecArm(&evt);
+      break;
+    }
+    double t = time_precise() - t0;
+    total += t;
+    if (t > tmax)
+      tmax = t;
+  }
+
+  unsigned int msgs{0}, bytes{0};
+  for (auto item : g_mcu_list)
+  {
+    MIDIOutputStats stats{};
+    if (GetThreadedMIDIOutputStats(item->m_midiout, &stats))
+    {
+      msgs += stats.enqueued;
+      bytes += stats.enqueued_bytes;
+    }
+  }
 
-  g_mcu_list[device]->midiBuffer.erase(g_mcu_list[device]->midiBuffer.begin() +
-                                       msgIdx);
-  return (int)g_mcu_list[device]->midiBuffer.size();
+  char buf[512];
+  int sz = snprintf(
+    buf, sizeof(buf),
+    "{\"scenario\":\"%s\",\"iterations\":%d,\"devices\":%d,"
+    "\"tracks\":%d,\"total_us\":%.0f,\"avg_us\":%.3f,\"max_us\":%.3f,"
+    "\"messages\":%u,\"bytes\":%u}",
+    names[scenario], iterations, (int)g_mcu_list.size(),
+    CSurf_NumTracks(g_csurf_mcpmode), total * 1000000.0,
+    total * 1000000.0 / iterations, tmax * 1000000.0, msgs - msgs0,
+    bytes - bytes0);
+  char* res = resultOutNeedBig;
+  if (resultOutNeedBig_sz != sz + 1 &&
+      !realloc_cmd_ptr(&res, &resultOutNeedBig_sz, sz + 1))
+  {
+    return -1;
+  }
+  memcpy(res, buf, sz + 1);
+  return 0;
 }
 
 static const char* defstring_SendMIDIMessage =
@@ -2854,6 +4038,13 @@ static int SendMIDIMessage(int device, int status, int data1, int data2,
   if (res > 0)
   {
     SendMIDIMessageToHardware(output, msgInOptional, msgInOptional_sz);
+    g_mcu_list[device]->InvalidateMackieDisplay(
+      (const unsigned char*)msgInOptional, msgInOptional_sz);
+    if (msgInOptional_sz >= 2)
+    {
+      status = (unsigned char)msgInOptional[0];
+      data1 = (unsigned char)msgInOptional[1];
+    }
   }
   else
   {
@@ -2862,6 +4053,10 @@ static int SendMIDIMessage(int device, int status, int data1, int data2,
                                         (unsigned char)(data1 & 7),
                                         (unsigned char)(data2 & 7), -1);
   }
+  // bypasses surface state, device may now show anything there
+  if ((status & 0xf0) == 0xe0)
+    data1 = status & 0xf;
+  g_mcu_list[device]->InvalidateSurfaceState(status, data1, data1);
   return res;
 }
 
@@ -2881,6 +4076,47 @@ void RegisterAPI()
     "APIvararg_MCULive_GetMIDIMessage",
     reinterpret_cast<void*>(&InvokeReaScriptAPI<&GetMIDIMessage>));
 
+  plugin_register("API_MCULive_GetMIDIMessages", (void*)&GetMIDIMessages);
+  plugin_register("APIdef_MCULive_GetMIDIMessages",
+                  (void*)defstring_GetMIDIMessages);
+  plugin_register(
+    "APIvararg_MCULive_GetMIDIMessages",
+    reinterpret_cast<void*>(&InvokeReaScriptAPI<&GetMIDIMessages>));
+
+  plugin_register("API_MCULive_GetOutputMessages", (void*)&GetOutputMessages);
+  plugin_register("APIdef_MCULive_GetOutputMessages",
+                  (void*)defstring_GetOutputMessages);
+  plugin_register(
+    "APIvararg_MCULive_GetOutputMessages",
+    reinterpret_cast<void*>(&InvokeReaScriptAPI<&GetOutputMessages>));
+
+  plugin_register("API_MCULive_InjectMIDIMessage", (void*)&InjectMIDIMessage);
+  plugin_register("APIdef_MCULive_InjectMIDIMessage",
+                  (void*)defstring_InjectMIDIMessage);
+  plugin_register(
+    "APIvararg_MCULive_InjectMIDIMessage",
+    reinterpret_cast<void*>(&InvokeReaScriptAPI<&InjectMIDIMessage>));
+
+  plugin_register("API_MCULive_Benchmark", (void*)&Benchmark);
+  plugin_register("APIdef_MCULive_Benchmark", (void*)defstring_Benchmark);
+  plugin_register("APIvararg_MCULive_Benchmark",
+                  reinterpret_cast<void*>(&InvokeReaScriptAPI<&Benchmark>));
+
+  plugin_register("API_MCULive_GetStats", (void*)&GetStats);
+  plugin_register("APIdef_MCULive_GetStats", (void*)defstring_GetStats);
+  plugin_register("APIvararg_MCULive_GetStats",
+                  reinterpret_cast<void*>(&InvokeReaScriptAPI<&GetStats>));
+
+  plugin_register("API_MCULive_DumpTrace", (void*)&DumpTrace);
+  plugin_register("APIdef_MCULive_DumpTrace", (void*)defstring_DumpTrace);
+  plugin_register("APIvararg_MCULive_DumpTrace",
+                  reinterpret_cast<void*>(&InvokeReaScriptAPI<&DumpTrace>));
+
+  plugin_register("API_MCULive_ReplayTrace", (void*)&ReplayTrace);
+  plugin_register("APIdef_MCULive_ReplayTrace", (void*)defstring_ReplayTrace);
+  plugin_register("APIvararg_MCULive_ReplayTrace",
+                  reinterpret_cast<void*>(&InvokeReaScriptAPI<&ReplayTrace>));
+
   plugin_register("API_MCULive_GetDevice", (void*)&GetDevice);
   plugin_register("APIdef_MCULive_GetDevice", (void*)defstring_GetDevice);
   plugin_register("APIvararg_MCULive_GetDevice",
@@ -2940,6 +4176,14 @@ void RegisterAPI()
     "APIvararg_MCULive_GetEncoderValue",
     reinterpret_cast<void*>(&InvokeReaScriptAPI<&GetEncoderValue>));
 
+  plugin_register("API_MCULive_GetSurfaceSnapshot",
+                  (void*)&GetSurfaceSnapshot);
+  plugin_register("APIdef_MCULive_GetSurfaceSnapshot",
+                  (void*)defstring_GetSurfaceSnapshot);
+  plugin_register(
+    "APIvararg_MCULive_GetSurfaceSnapshot",
+    reinterpret_cast<void*>(&InvokeReaScriptAPI<&GetSurfaceSnapshot>));
+
   plugin_register("API_MCULive_SetFaderValue", (void*)&SetFaderValue);
   plugin_register("APIdef_MCULive_SetFaderValue",
                   (void*)defstring_SetFaderValue);
@@ -2967,6 +4211,13 @@ void RegisterAPI()
     "APIvararg_MCULive_SetButtonPassthrough",
     reinterpret_cast<void*>(&InvokeReaScriptAPI<&SetButtonPassthrough>));
 
+  plugin_register("API_MCULive_SetDeviceOption", (void*)&SetDeviceOption);
+  plugin_register("APIdef_MCULive_SetDeviceOption",
+                  (void*)defstring_SetDeviceOption);
+  plugin_register(
+    "APIvararg_MCULive_SetDeviceOption",
+    reinterpret_cast<void*>(&InvokeReaScriptAPI<&SetDeviceOption>));
+
   plugin_register("API_MCULive_SetDefault", (void*)&SetDefault);
   plugin_register("APIdef_MCULive_SetDefault", (void*)defstring_SetDefault);
   plugin_register("APIvararg_MCULive_SetDefault",
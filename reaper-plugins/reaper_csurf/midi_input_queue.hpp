@@ -0,0 +1,234 @@
+#ifndef _MIDI_INPUT_QUEUE_HPP_
+#define _MIDI_INPUT_QUEUE_HPP_
+
+#include <reaper_plugin.h>
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+namespace ReaMCULive
+{
+
+#define MIDIIN_QUEUE_SIZE 256
+#define MIDIIN_QUEUE_MAX 65536
+#define MIDIIN_ARENA_SIZE 65536 // bytes for messages longer than 4 bytes
+
+// what MIDIInputQueue::Push does when queue is full
+enum
+{
+  MIDIIN_DROP_OLDEST = 0,
+  MIDIIN_DROP_NEWEST = 1,
+  MIDIIN_COALESCE = 2, // replace queued value of same fader/pressure, else
+                       // drop oldest
+};
+
+// Bounded FIFO of incoming messages kept for scripts, main thread only.
+// Slots are allocated when capacity is set, never on Push(). Long messages
+// (SysEx) are stored whole in a byte ring allocated in queue order, popping
+// a message frees everything allocated before its end.
+class MIDIInputQueue
+{
+public:
+  MIDIInputQueue()
+  {
+    SetCapacity(MIDIIN_QUEUE_SIZE);
+  }
+
+  // clears queue
+  bool SetCapacity(int capacity)
+  {
+    if (capacity < 1 || capacity > MIDIIN_QUEUE_MAX)
+      return false;
+    m_slots.assign(capacity, Slot{});
+    m_arena.resize(MIDIIN_ARENA_SIZE);
+    Clear();
+    return true;
+  }
+
+  bool SetPolicy(int policy)
+  {
+    if (policy < MIDIIN_DROP_OLDEST || policy > MIDIIN_COALESCE)
+      return false;
+    m_policy = policy;
+    return true;
+  }
+
+  void Push(const MIDI_event_t* evt)
+  {
+    const int cap = (int)m_slots.size();
+    const int len = evt->size;
+    if (len < 0 || len > (int)m_arena.size())
+    {
+      m_dropped++;
+      return;
+    }
+    if (m_size == cap)
+    {
+      if (m_policy == MIDIIN_COALESCE && Coalesce(evt))
+      {
+        m_coalesced++;
+        return;
+      }
+      m_dropped++;
+      if (m_policy == MIDIIN_DROP_NEWEST)
+        return;
+      Remove(0);
+    }
+
+    Slot* slot = &m_slots[(m_head + m_size) % cap];
+    slot->frame_offset = evt->frame_offset;
+    slot->size = len;
+    if (len > (int)sizeof(slot->msg))
+    {
+      while (!ArenaAlloc(len, &slot->pos))
+      {
+        // no room for payload, same policy as for full queue
+        m_dropped++;
+        if (m_policy == MIDIIN_DROP_NEWEST || m_size == 0)
+          return;
+        Remove(0);
+        slot = &m_slots[(m_head + m_size) % cap];
+      }
+      slot->frame_offset = evt->frame_offset;
+      slot->size = len;
+      memcpy(&m_arena[slot->pos % m_arena.size()], evt->midi_message, len);
+    }
+    else
+    {
+      memcpy(slot->msg, evt->midi_message, len);
+    }
+    m_size++;
+  }
+
+  // idx 0 is oldest, returns message bytes
+  const unsigned char* Get(int idx, int* size, int* frame_offset) const
+  {
+    const Slot* slot = &m_slots[(m_head + idx) % m_slots.size()];
+    *size = slot->size;
+    *frame_offset = slot->frame_offset;
+    if (slot->size > (int)sizeof(slot->msg))
+      return &m_arena[slot->pos % m_arena.size()];
+    return slot->msg;
+  }
+
+  // O(1) for oldest, otherwise moves later entries
+  void Remove(int idx)
+  {
+    const int cap = (int)m_slots.size();
+    if (idx < 0 || idx >= m_size)
+      return;
+    if (idx == 0)
+    {
+      const Slot* slot = &m_slots[m_head];
+      if (slot->size > (int)sizeof(slot->msg))
+        m_arena_head = slot->pos + slot->size;
+      m_head = (m_head + 1) % cap;
+    }
+    else
+    {
+      for (int i = idx; i < m_size - 1; i++)
+        m_slots[(m_head + i) % cap] = m_slots[(m_head + i + 1) % cap];
+    }
+    m_size--;
+    if (!m_size)
+      Clear();
+  }
+
+  void Clear()
+  {
+    m_head = 0;
+    m_size = 0;
+    m_arena_head = 0;
+    m_arena_tail = 0;
+  }
+
+  int GetSize() const
+  {
+    return m_size;
+  }
+
+  bool IsEmpty() const
+  {
+    return m_size == 0;
+  }
+
+  int GetCapacity() const
+  {
+    return (int)m_slots.size();
+  }
+
+  int GetPolicy() const
+  {
+    return m_policy;
+  }
+
+  unsigned int GetDropped() const
+  {
+    return m_dropped;
+  }
+
+  unsigned int GetCoalesced() const
+  {
+    return m_coalesced;
+  }
+
+private:
+  struct Slot
+  {
+    int frame_offset;
+    int size;
+    uint64_t pos;         // arena position if size > sizeof(msg)
+    unsigned char msg[4]; // else message
+  };
+
+  // contiguous len bytes at absolute position *pos, skips end of arena
+  bool ArenaAlloc(int len, uint64_t* pos)
+  {
+    const uint64_t asz = m_arena.size();
+    uint64_t tail = m_arena_tail;
+    if (tail % asz + len > asz)
+      tail += asz - tail % asz;
+    if (tail + len - m_arena_head > asz)
+      return false;
+    *pos = tail;
+    m_arena_tail = tail + len;
+    return true;
+  }
+
+  // newest queued message for same pitch bend or channel pressure target
+  // takes new value in place
+  bool Coalesce(const MIDI_event_t* evt)
+  {
+    const unsigned char status = evt->midi_message[0];
+    if (evt->size > 3 || ((status & 0xf0) != 0xe0 && (status & 0xf0) != 0xd0))
+      return false;
+
+    const int cap = (int)m_slots.size();
+    for (int i = m_size - 1; i >= 0; i--)
+    {
+      Slot* q = &m_slots[(m_head + i) % cap];
+      if (q->size == evt->size && q->msg[0] == status)
+      {
+        q->frame_offset = evt->frame_offset;
+        memcpy(q->msg, evt->midi_message, evt->size);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  std::vector<Slot> m_slots;
+  std::vector<unsigned char> m_arena;
+  uint64_t m_arena_head{0}; // absolute, first byte in use
+  uint64_t m_arena_tail{0}; // absolute, next free byte
+  int m_head{0};
+  int m_size{0};
+  int m_policy{MIDIIN_DROP_OLDEST};
+  unsigned int m_dropped{0};
+  unsigned int m_coalesced{0};
+};
+
+} // namespace ReaMCULive
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef _MIDI_OUTPUT_PACER_HPP_
+#define _MIDI_OUTPUT_PACER_HPP_
+
+namespace ReaMCULive
+{
+
+// MCU needs time to process SysEx (e.g. LCD), keep this gap between them
+#define MIDIOUT_SYSEX_GAP 0.005 // seconds
+
+// byte budget bucket depth, at least one full LCD SysEx
+#define MIDIOUT_BURST_TIME 0.010 // seconds
+#define MIDIOUT_BURST_MIN 256    // bytes
+
+// Token bucket of bytes/second plus minimum gap between SysEx messages.
+// Caller supplies the clock, times in seconds.
+class MIDIOutputPacer
+{
+public:
+  void SetRate(double bytes_per_sec) // 0 = unlimited
+  {
+    if (bytes_per_sec == m_rate)
+      return;
+    m_rate = bytes_per_sec > 0.0 ? bytes_per_sec : 0.0;
+    m_burst = m_rate * MIDIOUT_BURST_TIME;
+    if (m_burst < MIDIOUT_BURST_MIN)
+      m_burst = MIDIOUT_BURST_MIN;
+    m_tokens = m_burst;
+  }
+
+  void SetSysExGap(double gap)
+  {
+    m_gap = gap > 0.0 ? gap : 0.0;
+  }
+
+  // earliest time len bytes can be sent, <= now if right away
+  double GetSendTime(int len, bool sysex, double now)
+  {
+    double t = now;
+    if (sysex && m_lastsysex + m_gap > t)
+      t = m_lastsysex + m_gap;
+
+    if (m_rate > 0.0)
+    {
+      Refill(now);
+      // messages larger than bucket go when it is full
+      double need = (len < m_burst ? len : m_burst) - m_tokens;
+      if (need > 0.0 && now + need / m_rate > t)
+        t = now + need / m_rate;
+    }
+    return t;
+  }
+
+  void OnSend(int len, bool sysex, double now)
+  {
+    if (sysex)
+      m_lastsysex = now;
+    if (m_rate > 0.0)
+    {
+      Refill(now);
+      m_tokens -= len;
+    }
+  }
+
+private:
+  void Refill(double now)
+  {
+    if (now > m_lastrefill)
+    {
+      m_tokens += (now - m_lastrefill) * m_rate;
+      if (m_tokens > m_burst)
+        m_tokens = m_burst;
+    }
+    m_lastrefill = now;
+  }
+
+  double m_rate{0.0};
+  double m_burst{MIDIOUT_BURST_MIN};
+  double m_tokens{MIDIOUT_BURST_MIN};
+  double m_lastrefill{0.0};
+  double m_gap{MIDIOUT_SYSEX_GAP};
+  double m_lastsysex{-1.0};
+};
+
+} // namespace ReaMCULive
+
+#endif
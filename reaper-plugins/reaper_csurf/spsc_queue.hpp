@@ -0,0 +1,85 @@
+#ifndef _SPSC_QUEUE_HPP_
+#define _SPSC_QUEUE_HPP_
+
+#include <atomic>
+
+namespace ReaMCULive
+{
+
+#define CACHE_LINE_SIZE 64
+
+// Fixed capacity single-producer/single-consumer ring of preallocated slots.
+// Producer writes into Alloc() and publishes with Push(), consumer reads
+// Front() and releases with Pop(). Neither side allocates or locks.
+template <typename T, unsigned int N> class SPSCQueue
+{
+  static_assert(N && !(N & (N - 1)), "SPSCQueue capacity must be power of 2");
+
+public:
+  // producer: returns free slot or NULL if full
+  T* Alloc()
+  {
+    const unsigned int tail = m_tail.load(std::memory_order_relaxed);
+    if (tail - m_head_cache >= N)
+    {
+      m_head_cache = m_head.load(std::memory_order_acquire);
+      if (tail - m_head_cache >= N)
+        return NULL;
+    }
+    return &m_slots[tail & (N - 1)];
+  }
+
+  // producer: publishes slot returned by Alloc()
+  void Push()
+  {
+    m_tail.store(m_tail.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_release);
+  }
+
+  // consumer: returns oldest slot or NULL if empty
+  T* Front()
+  {
+    const unsigned int head = m_head.load(std::memory_order_relaxed);
+    if (head == m_tail_cache)
+    {
+      m_tail_cache = m_tail.load(std::memory_order_acquire);
+      if (head == m_tail_cache)
+        return NULL;
+    }
+    return &m_slots[head & (N - 1)];
+  }
+
+  // consumer: releases slot returned by Front()
+  void Pop()
+  {
+    m_head.store(m_head.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_release);
+  }
+
+  // approximate when called from a third thread
+  unsigned int GetSize() const
+  {
+    return m_tail.load(std::memory_order_acquire) -
+           m_head.load(std::memory_order_acquire);
+  }
+
+  static constexpr unsigned int GetCapacity()
+  {
+    return N;
+  }
+
+private:
+  // consumer line
+  alignas(CACHE_LINE_SIZE) std::atomic<unsigned int> m_head{0};
+  unsigned int m_tail_cache{0};
+
+  // producer line
+  alignas(CACHE_LINE_SIZE) std::atomic<unsigned int> m_tail{0};
+  unsigned int m_head_cache{0};
+
+  alignas(CACHE_LINE_SIZE) T m_slots[N];
+};
+
+} // namespace ReaMCULive
+
+#endif
@@ -0,0 +1,128 @@
+#ifndef _SURFACE_TRACE_HPP_
+#define _SURFACE_TRACE_HPP_
+
+#include <reaper_plugin.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+namespace ReaMCULive
+{
+
+#define TRACE_SIZE 4096 // records per device, power of 2
+#define TRACE_MAGIC "MCUTRACE"
+#define TRACE_VERSION 1
+
+enum
+{
+  TRACE_IN = 1,          // MIDI from device or MCULive_InjectMIDIMessage
+  TRACE_OUT,             // MIDI to device
+  TRACE_SET_VOLUME = 16, // REAPER callbacks, track and value
+  TRACE_SET_PAN,
+  TRACE_SET_MUTE,
+  TRACE_SET_SELECTED,
+  TRACE_SET_SOLO,
+  TRACE_SET_RECARM,
+  TRACE_SET_PLAYSTATE, // value = play | pause << 1 | rec << 2
+  TRACE_SET_TRACKTITLE,
+  TRACE_TRACKLIST_CHANGE,
+};
+
+// 24 bytes, also file format after header
+struct TraceRecord
+{
+  double time; // time_precise()
+  uint8_t type;
+  uint8_t reserved;
+  uint16_t size;  // MIDI message length, SysEx clamped to 65535
+  uint8_t msg[4]; // first bytes of MIDI message
+  int32_t track;  // callbacks: CSurf_TrackToID(), -1 if none
+  float value;    // callbacks
+};
+
+// Fixed size ring of last TRACE_SIZE records, overwritten oldest first.
+// Written from main thread only, no locking or allocation after creation.
+class SurfaceTrace
+{
+public:
+  SurfaceTrace() : m_records(TRACE_SIZE)
+  {
+  }
+
+  void AddMIDI(double time, int type, const MIDI_event_t* evt)
+  {
+    TraceRecord* rec = Next(time, type);
+    int n = evt->size < 4 ? evt->size : 4;
+    rec->size = evt->size > 0xffff ? 0xffff : (uint16_t)evt->size;
+    memcpy(rec->msg, evt->midi_message, n < 0 ? 0 : n);
+  }
+
+  void AddCallback(double time, int type, int track, double value)
+  {
+    TraceRecord* rec = Next(time, type);
+    rec->track = track;
+    rec->value = (float)value;
+  }
+
+  int GetSize() const
+  {
+    return m_count < TRACE_SIZE ? (int)m_count : TRACE_SIZE;
+  }
+
+  // idx 0 is oldest
+  const TraceRecord* Get(int idx) const
+  {
+    return &m_records[(m_count - GetSize() + idx) & (TRACE_SIZE - 1)];
+  }
+
+  // header: magic, int32 version, int32 record size, int32 count
+  int Write(FILE* fp) const
+  {
+    const int32_t hdr[3] = {TRACE_VERSION, (int32_t)sizeof(TraceRecord),
+                            GetSize()};
+    if (fwrite(TRACE_MAGIC, 8, 1, fp) != 1 ||
+        fwrite(hdr, sizeof(hdr), 1, fp) != 1)
+      return -1;
+    for (int i = 0; i < GetSize(); i++)
+    {
+      if (fwrite(Get(i), sizeof(TraceRecord), 1, fp) != 1)
+        return -1;
+    }
+    return GetSize();
+  }
+
+  static bool Read(FILE* fp, std::vector<TraceRecord>* records)
+  {
+    char magic[8];
+    int32_t hdr[3];
+    if (fread(magic, 8, 1, fp) != 1 || memcmp(magic, TRACE_MAGIC, 8) ||
+        fread(hdr, sizeof(hdr), 1, fp) != 1 || hdr[0] != TRACE_VERSION ||
+        hdr[1] != (int32_t)sizeof(TraceRecord) || hdr[2] < 0 ||
+        hdr[2] > TRACE_SIZE) // Write() never stores more than the ring
+      return false;
+    records->resize(hdr[2]);
+    return !hdr[2] ||
+           fread(records->data(), sizeof(TraceRecord), hdr[2], fp) ==
+             (size_t)hdr[2];
+  }
+
+private:
+  TraceRecord* Next(double time, int type)
+  {
+    TraceRecord* rec = &m_records[m_count++ & (TRACE_SIZE - 1)];
+    memset(rec, 0, sizeof(*rec));
+    rec->time = time;
+    rec->type = (uint8_t)type;
+    rec->track = -1;
+    return rec;
+  }
+
+  std::vector<TraceRecord> m_records;
+  unsigned int m_count{0};
+};
+
+} // namespace ReaMCULive
+
+#endif
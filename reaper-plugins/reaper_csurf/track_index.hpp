@@ -0,0 +1,75 @@
+#ifndef _TRACK_INDEX_HPP_
+#define _TRACK_INDEX_HPP_
+
+#include <stdint.h>
+#include <string.h>
+#include <unordered_map>
+
+namespace ReaMCULive
+{
+
+struct GUIDHash
+{
+  size_t operator()(const GUID& g) const
+  {
+    uint64_t a, b;
+    memcpy(&a, &g, sizeof(a));
+    memcpy(&b, (const char*)&g + sizeof(a), sizeof(b));
+    return (size_t)(a ^ (b * 0x9e3779b97f4a7c15ull));
+  }
+};
+
+struct GUIDEqual
+{
+  bool operator()(const GUID& a, const GUID& b) const
+  {
+    return !memcmp(&a, &b, sizeof(GUID));
+  }
+};
+
+// GUID index of one project's tracks. Owner refills it with Clear, Add and
+// SetValid when IsValid fails, i.e. after Invalidate or project switch.
+template <class T> class TrackGUIDIndex
+{
+public:
+  void Invalidate()
+  {
+    m_valid = false;
+  }
+
+  bool IsValid(const void* proj) const
+  {
+    return m_valid && m_proj == proj;
+  }
+
+  void Clear()
+  {
+    m_map.clear(); // keeps buckets
+  }
+
+  void Add(const GUID& guid, T* tr)
+  {
+    m_map.emplace(guid, tr);
+  }
+
+  void SetValid(const void* proj)
+  {
+    m_proj = proj;
+    m_valid = true;
+  }
+
+  T* Find(const GUID& guid) const
+  {
+    auto it = m_map.find(guid);
+    return it != m_map.end() ? it->second : NULL;
+  }
+
+private:
+  std::unordered_map<GUID, T*, GUIDHash, GUIDEqual> m_map;
+  bool m_valid{false};
+  const void* m_proj{nullptr};
+};
+
+} // namespace ReaMCULive
+
+#endif
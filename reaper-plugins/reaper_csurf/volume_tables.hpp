@@ -0,0 +1,111 @@
+#ifndef _VOLUME_TABLES_HPP_
+#define _VOLUME_TABLES_HPP_
+
+#include "reaper_plugin_functions.h"
+
+#include "../../WDL/db2val.h"
+
+#include <algorithm>
+#include <math.h>
+
+namespace ReaMCULive
+{
+
+// Fader position <-> gain goes through SLIDER2DB/DB2SLIDER and
+// DB2VAL/VAL2DB. Both directions are tabulated once at load, see
+// InitVolumeTables. g_vol_int14_edge[i] is lowest gain the per call
+// conversion (volToInt14Calc) puts at position i or above, so gain ->
+// position is a binary search with the same result.
+static double g_int14_vol[16384];
+static double g_vol_int14_edge[16384];
+static double g_vol_char_edge[128];
+
+static double int14ToVolCalc(int val)
+{
+  double pos = ((double)val * 1000.0) / 16383.0;
+  pos = SLIDER2DB(pos);
+  return DB2VAL(pos);
+}
+
+static int volToInt14Calc(double vol)
+{
+  double d = (DB2SLIDER(VAL2DB(vol)) * 16383.0 / 1000.0);
+  if (d < 0.0)
+    d = 0.0;
+  else if (d > 16383.0)
+    d = 16383.0;
+
+  return (int)(d + 0.5);
+}
+
+static int volToCharCalc(double vol)
+{
+  double d = (DB2SLIDER(VAL2DB(vol)) * 127.0 / 1000.0);
+  if (d < 0.0)
+    d = 0.0;
+  else if (d > 127.0)
+    d = 127.0;
+
+  return (int)(d + 0.5);
+}
+
+// Lowest gain calc() puts at pos or above. guess is the inverse through
+// SLIDER2DB, off by rounding only, so it is moved a bounded number of ulps.
+static double VolumeEdge(double guess, int pos, int (*calc)(double))
+{
+  for (int i = 0; i < 1024 && calc(guess) < pos; i++)
+    guess = nextafter(guess, HUGE_VAL);
+  for (int i = 0; i < 1024 && calc(nextafter(guess, -HUGE_VAL)) >= pos; i++)
+    guess = nextafter(guess, -HUGE_VAL);
+  return guess;
+}
+
+// Positions up to where VAL2DB floor (-150 dB) lands are reached by any
+// gain, also 0 and below, so their edges are -inf.
+static void InitVolumeEdges(double* edge, int n, int (*calc)(double))
+{
+  int lowest = calc(0.0);
+  edge[0] = -HUGE_VAL;
+  for (int i = 1; i < n; i++)
+  {
+    if (i <= lowest)
+      edge[i] = -HUGE_VAL;
+    else
+      edge[i] = VolumeEdge(DB2VAL(SLIDER2DB((i - 0.5) * 1000.0 / (n - 1))),
+                           i, calc);
+  }
+}
+
+static void InitVolumeTables()
+{
+  for (int i = 0; i < 16384; i++)
+    g_int14_vol[i] = int14ToVolCalc(i);
+
+  InitVolumeEdges(g_vol_int14_edge, 16384, volToInt14Calc);
+  InitVolumeEdges(g_vol_char_edge, 128, volToCharCalc);
+}
+
+static double int14ToVol(unsigned char msb, unsigned char lsb)
+{
+  return g_int14_vol[(lsb | (msb << 7)) & 16383];
+}
+
+static int volToInt14(double vol)
+{
+  // last position whose edge is at or below vol
+  return (int)(std::upper_bound(g_vol_int14_edge + 1, g_vol_int14_edge + 16384,
+                                vol) -
+               g_vol_int14_edge) -
+         1;
+}
+
+static unsigned char volToChar(double vol)
+{
+  return (unsigned char)(std::upper_bound(g_vol_char_edge + 1,
+                                          g_vol_char_edge + 128, vol) -
+                         g_vol_char_edge - 1);
+}
+
+} // namespace ReaMCULive
+
+#endif
@@ -10,20 +10,18 @@ function f()
     
     -- for each device
     for devId = 0, devices - 1 do
-      -- get size (or length, or number) of available MIDI messages in buffer/queue
-      size = reaper.MCULive_GetMIDIMessage(devId, -1)
-      
-      count = 0 -- count messages in current buffer, just for the sake of it
-      
-      -- here we pull MIDI messages from buffer until there are no more left
+      -- pull all MIDI messages from buffer/queue in one call
       -- new MIDI buffer available at next defer cycle
-      while size > 0 do
-        size, status, data1, data2, frame_offset, msg = reaper.MCULive_GetMIDIMessage(devId, 0)
+      count, buf = reaper.MCULive_GetMIDIMessages(devId, '')
+      
+      pos = 1
+      for i = 1, count do
+        frame_offset, msg, pos = string.unpack('<i4s4', buf, pos)
+        status, data1, data2 = msg:byte(1, 3)
         -- here-do-whatever
         -- handle status, data1, data2, frame_offset
-        -- check msg for long message
-        -- e.g. reaper.ShowConsoleMsg(devId .. '\t' .. count .. '\t' .. frame_offset.. '\t' .. status .. '\t' .. data1 .. '\t' .. data2 .. '\n')
-        count = count + 1 -- increase counter
+        -- check #msg > 3 for long message
+        -- e.g. reaper.ShowConsoleMsg(devId .. '\t' .. i .. '\t' .. frame_offset.. '\t' .. status .. '\t' .. data1 .. '\t' .. data2 .. '\n')
       end
       
       -- send some messages to MIDI devices
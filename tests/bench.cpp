@@ -0,0 +1,375 @@
+// Surface cost benchmarks on stubbed REAPER. Each result is one JSON object
+// per line on stdout: wall time of main thread work, REAPER API calls made
+// (time_precise excluded) and MIDI messages/bytes that reached devices.
+//
+//   reamculive_bench [--quick] [--iterations n] [scenario ...]
+//
+// Scenarios sweep project sizes 16/128/1024 tracks and 1-8 devices (MCU
+// plus extenders), --quick only 16 tracks and 1-2 devices. "guid" runs
+// 10/100/1000 tracks on one device.
+
+#include "reaper_stub.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace ReaperStub;
+
+struct BenchConfig
+{
+  std::vector<int> tracks;
+  std::vector<int> devices;
+  int iterations;
+};
+
+struct BenchResult
+{
+  double total; // seconds
+  double max;
+  int iterations;
+  int events; // input events per iteration, 0 if none
+  std::vector<uint64_t> calls; // per API
+};
+
+static double Now()
+{
+  using namespace std::chrono;
+  return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+// REAPER calls Run() at csurfrate, 30 Hz by default
+static void Frame()
+{
+  Advance(1.0 / 30.0);
+  RunSurfaces();
+}
+
+static void Press(int dev, unsigned char note)
+{
+  unsigned char msg[3] = {0x90, note, 0x7f};
+  SendInput(dev, msg, 3);
+  msg[2] = 0;
+  SendInput(dev, msg, 3);
+}
+
+// fresh project and surfaces, output of initial refresh discarded
+static void Setup(int tracks, int devices)
+{
+  DestroySurfaces();
+  SetTrackCount(tracks);
+  for (int i = 0; i < devices; i++)
+    CreateSurface(i > 0, i * 8, 8, i, i);
+  UpdateAllSurfaces();
+  Frame();
+  WaitOutput();
+  ClearOutput();
+  ResetCounters();
+}
+
+static void PrintResult(const char* scenario, int tracks, int devices,
+                        const BenchResult& res)
+{
+  WaitOutput();
+  uint64_t calls = 0;
+  for (int i = 0; i < (int)res.calls.size(); i++)
+  {
+    if (strcmp(GetAPIName(i), "time_precise"))
+      calls += res.calls[i];
+  }
+
+  printf("{\"scenario\":\"%s\",\"tracks\":%d,\"devices\":%d,"
+         "\"iterations\":%d,\"total_us\":%.0f,\"avg_us\":%.3f,"
+         "\"max_us\":%.3f,\"api_calls\":%llu,\"messages\":%llu,"
+         "\"bytes\":%llu,",
+         scenario, tracks, devices, res.iterations, res.total * 1e6,
+         res.total * 1e6 / res.iterations, res.max * 1e6,
+         (unsigned long long)calls,
+         (unsigned long long)GetOutputMessages(),
+         (unsigned long long)GetOutputBytes());
+  if (res.events)
+  {
+    printf("\"events\":%d,\"event_avg_ns\":%.1f,", res.events,
+           res.total * 1e9 / res.iterations / res.events);
+  }
+  printf("\"api\":{");
+  const char* sep = "";
+  for (int i = 0; i < (int)res.calls.size(); i++)
+  {
+    if (res.calls[i] && strcmp(GetAPIName(i), "time_precise"))
+    {
+      printf("%s\"%s\":%llu", sep, GetAPIName(i),
+             (unsigned long long)res.calls[i]);
+      sep = ",";
+    }
+  }
+  printf("}}\n");
+  fflush(stdout);
+}
+
+static std::vector<uint64_t> GetCalls()
+{
+  std::vector<uint64_t> calls(GetAPICount());
+  for (int api = 0; api < GetAPICount(); api++)
+    calls[api] = GetAPICalls(api);
+  return calls;
+}
+
+// times fn() iterations times, prepare() runs untimed before each. Output
+// is drained between iterations so queues do not overflow, calls made while
+// draining are not counted.
+template <class P, class F>
+static BenchResult Measure(int iterations, int events, P prepare, F fn)
+{
+  BenchResult res{0.0, 0.0, iterations, events,
+                  std::vector<uint64_t>(GetAPICount())};
+  for (int i = 0; i < iterations; i++)
+  {
+    prepare(i);
+    std::vector<uint64_t> calls0 = GetCalls();
+    double t0 = Now();
+    fn();
+    double t = Now() - t0;
+    std::vector<uint64_t> calls = GetCalls();
+
+    res.total += t;
+    if (t > res.max)
+      res.max = t;
+    for (int api = 0; api < GetAPICount(); api++)
+      res.calls[api] += calls[api] - calls0[api];
+    WaitOutput();
+  }
+  return res;
+}
+
+/*
+** scenarios
+*/
+
+struct Sweep
+{
+  const char* name;
+  void (*prepare)(int iteration); // NULL if none
+  void (*fn)();
+  int events; // input events prepare() queues
+};
+
+static void BenchSweep(const BenchConfig& cfg, const Sweep& sweep)
+{
+  for (int tracks : cfg.tracks)
+  {
+    for (int devices : cfg.devices)
+    {
+      Setup(tracks, devices);
+      BenchResult res = Measure(
+        cfg.iterations, sweep.events,
+        [&](int i) {
+          if (sweep.prepare)
+            sweep.prepare(i);
+        },
+        sweep.fn);
+      PrintResult(sweep.name, tracks, devices, res);
+    }
+  }
+}
+
+// Run() of all surfaces with nothing changed, baseline of the others
+static void BenchRun()
+{
+  Frame();
+}
+
+// every track's volume and name differ from last refresh
+static void PrepareRefresh(int iteration)
+{
+  for (int i = 0; i < GetTrackCount(); i++)
+  {
+    GetTrack(i)->vol = iteration & 1 ? 1.0 : 0.5;
+    GetTrack(i)->name = iteration & 1 ? "" : "Vox " + std::to_string(i);
+  }
+}
+
+// TrackList_UpdateAllExternalSurfaces(), e.g. after project load or undo
+static void BenchRefresh()
+{
+  UpdateAllSurfaces();
+  Frame();
+}
+
+// bank right and back on first device
+static void BenchBank()
+{
+  Press(0, 0x2f);
+  Frame();
+  Press(0, 0x2e);
+  Frame();
+}
+
+// pan/surround mode on and back on first device. Mode buttons have no
+// route from MIDI input, MCULive_Benchmark scenario 2 calls OnModeSet().
+static void BenchMode()
+{
+  typedef int (*BenchmarkFunc)(int, int, char*, int);
+  static auto benchmark = (BenchmarkFunc)GetPluginAPI("MCULive_Benchmark");
+  int sz;
+  char* buf = GetCmdBuffer(&sz);
+  if (benchmark)
+    benchmark(2, 1, buf, sz);
+  Frame();
+}
+
+// rec arm buttons of first device select bank page, second page and back
+static void BenchRecArm()
+{
+  Press(0, 0x01);
+  Frame();
+  Press(0, 0x00);
+  Frame();
+}
+
+// MCU input as recorded from a mix pass, four times over: each strip's
+// fader touched, moved and released, v-pot turned both ways and mute
+// toggled, then jog wheel and play. Mutes end where they started every
+// second iteration.
+static const std::vector<std::vector<unsigned char>>& DispatchStream()
+{
+  static std::vector<std::vector<unsigned char>> stream;
+  if (stream.empty())
+  {
+    for (int pass = 0; pass < 4; pass++)
+    {
+      for (unsigned char s = 0; s < 8; s++)
+      {
+        stream.push_back({0x90, (unsigned char)(0x68 + s), 0x7f});
+        for (int v = 0; v < 16; v++)
+          stream.push_back(
+            {(unsigned char)(0xe0 + s), 0, (unsigned char)(v * 8)});
+        stream.push_back({0x90, (unsigned char)(0x68 + s), 0x00});
+        for (int v = 0; v < 8; v++)
+          stream.push_back({0xb0, (unsigned char)(0x10 + s),
+                            (unsigned char)(v < 4 ? 0x01 : 0x41)});
+        stream.push_back({0x90, (unsigned char)(0x10 + s), 0x7f});
+        stream.push_back({0x90, (unsigned char)(0x10 + s), 0x00});
+      }
+      for (int v = 0; v < 8; v++)
+        stream.push_back({0xb0, 0x3c, (unsigned char)(v < 4 ? 0x01 : 0x41)});
+      stream.push_back({0x90, 0x5e, 0x7f});
+      stream.push_back({0x90, 0x5e, 0x00});
+    }
+  }
+  return stream;
+}
+
+static void PrepareDispatch(int iteration)
+{
+  for (auto& msg : DispatchStream())
+    SendInput(0, msg.data(), (int)msg.size());
+}
+
+// remapped button, route table rebuilt by each MCULive_Map() call
+static void BenchRemap()
+{
+  typedef int (*MapFunc)(int, int, int, bool);
+  static auto map = (MapFunc)GetPluginAPI("MCULive_Map");
+  if (map)
+  {
+    map(0, 0x5b, 0x5c, true);
+    map(0, 0x5b, 0, true);
+  }
+}
+
+static const Sweep g_sweeps[] = {
+  {"run", NULL, &BenchRun, 0},
+  {"refresh", &PrepareRefresh, &BenchRefresh, 0},
+  {"bank", NULL, &BenchBank, 0},
+  {"mode", NULL, &BenchMode, 0},
+  {"recarm", NULL, &BenchRecArm, 0},
+  // Run() dispatching queued input, compare with "run"
+  {"dispatch", &PrepareDispatch, &BenchRun, (int)DispatchStream().size()},
+  {"remap", NULL, &BenchRemap, 0},
+};
+
+// Output track stored by GUID (MCULive output track, "mculiveout" project
+// ext state) resolved through the GUID index on first callback after track
+// list change. Last track is the output track, sweeps 10/100/1000 tracks.
+static void BenchGUID(const BenchConfig& cfg)
+{
+  for (int tracks : {10, 100, 1000})
+  {
+    Setup(tracks, 1);
+    GetTrack(tracks - 1)->name = "MCU Live";
+    UpdateAllSurfaces();
+    Frame();
+    WaitOutput();
+    ClearOutput();
+    ResetCounters();
+
+    // track list change drops index and cached output track, lookup is
+    // on first use
+    BenchResult res = Measure(
+      cfg.iterations, 0, [](int i) {},
+      [] {
+        GetSurface(0)->SetTrackListChange();
+        GetSurface(0)->SetSurfaceVolume(ToMediaTrack(GetTrack(0)), 1.0);
+      });
+    PrintResult("guid", tracks, 1, res);
+  }
+}
+
+static bool Wanted(const std::vector<std::string>& names, const char* name)
+{
+  if (names.empty())
+    return true;
+  for (auto& n : names)
+  {
+    if (n == name)
+      return true;
+  }
+  return false;
+}
+
+int main(int argc, char** argv)
+{
+  BenchConfig cfg{{16, 128, 1024}, {1, 2, 3, 4, 5, 6, 7, 8}, 50};
+  std::vector<std::string> names;
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "--quick"))
+    {
+      cfg.tracks = {16};
+      cfg.devices = {1, 2};
+      cfg.iterations = 3;
+    }
+    else if (!strcmp(argv[i], "--iterations") && i + 1 < argc)
+    {
+      cfg.iterations = atoi(argv[++i]);
+    }
+    else if (argv[i][0] == '-')
+    {
+      fprintf(stderr,
+              "usage: %s [--quick] [--iterations n] [scenario ...]\n",
+              argv[0]);
+      return 1;
+    }
+    else
+    {
+      names.push_back(argv[i]);
+    }
+  }
+  if (cfg.iterations < 1 || !LoadPlugin())
+    return 1;
+
+  for (auto& s : g_sweeps)
+  {
+    if (Wanted(names, s.name))
+      BenchSweep(cfg, s);
+  }
+  if (Wanted(names, "guid"))
+    BenchGUID(cfg);
+
+  DestroySurfaces();
+  return 0;
+}
@@ -0,0 +1,287 @@
+// Input dispatch micro-benchmark: MCU input of a mix pass resolved to its
+// handler through status and button route tables, and the same stream
+// through the handler chain and button handler scans they replaced. Also
+// times route rebuilds, as after MCULive_Map. One JSON object per line.
+//
+//   bench_button_routes [--quick]
+
+#include <reaper_plugin.h>
+
+#include "button_routes.hpp"
+
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+using namespace ReaMCULive;
+
+static double Now()
+{
+  using namespace std::chrono;
+  return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+// handlers only count, real ones work on surface state
+struct Surface
+{
+  typedef bool (Surface::*MidiHandlerFunc)(MIDI_event_t*);
+
+  int m_calls[8]{};
+  int m_button_remap[256]{};
+  int m_buttons_passthrough[256]{};
+  int m_press_only_buttons[256]{};
+  ButtonRoute<MidiHandlerFunc> m_button_routes[256];
+
+  bool OnRecArm(MIDI_event_t*)
+  {
+    return ++m_calls[0];
+  }
+  bool OnSoloDC(MIDI_event_t*)
+  {
+    return false;
+  }
+  bool OnMuteSolo(MIDI_event_t*)
+  {
+    return ++m_calls[1];
+  }
+  bool OnChannelSelect(MIDI_event_t*)
+  {
+    return false;
+  }
+  bool OnChannelSelectDC(MIDI_event_t*)
+  {
+    return ++m_calls[2];
+  }
+  bool OnBankChannel(MIDI_event_t*)
+  {
+    return ++m_calls[3];
+  }
+  bool OnMCULiveButton(MIDI_event_t*)
+  {
+    return ++m_calls[4];
+  }
+  bool OnKeyModifier(MIDI_event_t*)
+  {
+    return ++m_calls[4];
+  }
+  bool OnScroll(MIDI_event_t*)
+  {
+    return ++m_calls[4];
+  }
+  bool OnTouch(MIDI_event_t*)
+  {
+    return ++m_calls[5];
+  }
+  bool OnFaderMove(MIDI_event_t* evt)
+  {
+    return (evt->midi_message[0] & 0xf0) == 0xe0 && ++m_calls[6];
+  }
+  bool OnRotaryEncoder(MIDI_event_t* evt)
+  {
+    return (evt->midi_message[0] & 0xf0) == 0xb0 &&
+           evt->midi_message[1] != 0x3c && ++m_calls[7];
+  }
+  bool OnJogWheel(MIDI_event_t* evt)
+  {
+    return (evt->midi_message[0] & 0xf0) == 0xb0 &&
+           evt->midi_message[1] == 0x3c && ++m_calls[7];
+  }
+  bool OnMCUReset(MIDI_event_t* evt)
+  {
+    return evt->midi_message[0] == 0xf0;
+  }
+
+  static const ButtonHandler<MidiHandlerFunc>* GetHandlers()
+  {
+    static const ButtonHandler<MidiHandlerFunc> handlers[] = {
+      //
+      {0x00, 0x07, &Surface::OnRecArm, NULL},
+      {0x08, 0x0f, NULL, &Surface::OnSoloDC},
+      {0x08, 0x17, &Surface::OnMuteSolo, NULL},
+      {0x18, 0x1f, &Surface::OnChannelSelectDC, &Surface::OnChannelSelect},
+      {0x2e, 0x31, &Surface::OnBankChannel, NULL},
+      // Press and release events
+      {0x32, 0x45, &Surface::OnMCULiveButton, NULL},
+      {0x4a, 0x5f, &Surface::OnMCULiveButton, NULL},
+      {0x64, 0x67, &Surface::OnMCULiveButton, NULL},
+      {0x46, 0x49, &Surface::OnKeyModifier},
+      {0x60, 0x63, &Surface::OnScroll},
+      {0x68, 0x70, &Surface::OnTouch},
+    };
+    return handlers;
+  }
+
+  void BuildButtonRoutes()
+  {
+    ResolveButtonRoutes(m_button_routes, GetHandlers(), 11, 5, m_button_remap,
+                        m_buttons_passthrough, m_press_only_buttons);
+  }
+
+  // status table and route lookup
+  void OnMIDIEvent(MIDI_event_t* evt)
+  {
+    switch (evt->midi_message[0] >> 4)
+    {
+    case 0x9:
+    {
+      const ButtonRoute<MidiHandlerFunc>* r =
+        &m_button_routes[evt->midi_message[1]];
+      evt->midi_message[1] = r->code;
+      if (r->press_only)
+      {
+        if (evt->midi_message[2] >= 0x40 && r->press)
+          (this->*r->press)(evt);
+      }
+      else if (r->any)
+      {
+        (this->*r->any)(evt);
+      }
+      break;
+    }
+    case 0xb:
+      if (evt->midi_message[1] == 0x3c)
+        OnJogWheel(evt);
+      else
+        OnRotaryEncoder(evt);
+      break;
+    case 0xe:
+      OnFaderMove(evt);
+      break;
+    case 0xf:
+      OnMCUReset(evt);
+      break;
+    }
+  }
+
+  // five handlers in turn, buttons by scanning handler ranges
+  void OnMIDIEventScan(MIDI_event_t* evt)
+  {
+    static const MidiHandlerFunc handlers[] = {
+      &Surface::OnMCUReset, &Surface::OnFaderMove, &Surface::OnRotaryEncoder,
+      &Surface::OnJogWheel, &Surface::OnButtonPressScan,
+    };
+    for (auto func : handlers)
+    {
+      if ((this->*func)(evt))
+        return;
+    }
+  }
+
+  bool OnButtonPressScan(MIDI_event_t* evt)
+  {
+    if ((evt->midi_message[0] & 0xf0) != 0x90)
+      return false;
+    if (m_button_remap[evt->midi_message[1]])
+      evt->midi_message[1] = m_button_remap[evt->midi_message[1]];
+    unsigned int evt_code = evt->midi_message[1];
+    const ButtonHandler<MidiHandlerFunc>* handlers = GetHandlers();
+
+    if (m_press_only_buttons[evt_code] && evt->midi_message[2] >= 0x40)
+    {
+      for (int i = 0; i < 11; i++)
+      {
+        if (handlers[i].evt_min <= evt_code && evt_code <= handlers[i].evt_max &&
+            handlers[i].func && (this->*handlers[i].func)(evt))
+          return true;
+      }
+    }
+    for (int i = 5; i < 11; i++)
+    {
+      if (!m_press_only_buttons[evt_code] && handlers[i].evt_min <= evt_code &&
+          evt_code <= handlers[i].evt_max)
+        if ((this->*handlers[i].func)(evt))
+          return true;
+    }
+    return true;
+  }
+};
+
+// each strip's fader touched, moved and released, v-pot turned both ways,
+// mute and select pressed, then jog wheel, bank and transport
+static std::vector<std::vector<unsigned char>> RecordedStream()
+{
+  std::vector<std::vector<unsigned char>> stream;
+  for (unsigned char s = 0; s < 8; s++)
+  {
+    stream.push_back({0x90, (unsigned char)(0x68 + s), 0x7f});
+    for (int v = 0; v < 16; v++)
+      stream.push_back({(unsigned char)(0xe0 + s), 0, (unsigned char)(v * 8)});
+    stream.push_back({0x90, (unsigned char)(0x68 + s), 0x00});
+    for (int v = 0; v < 8; v++)
+      stream.push_back(
+        {0xb0, (unsigned char)(0x10 + s), (unsigned char)(v < 4 ? 1 : 0x41)});
+    for (unsigned char b : {0x10, 0x18})
+    {
+      stream.push_back({0x90, (unsigned char)(b + s), 0x7f});
+      stream.push_back({0x90, (unsigned char)(b + s), 0x00});
+    }
+  }
+  for (int v = 0; v < 8; v++)
+    stream.push_back({0xb0, 0x3c, (unsigned char)(v < 4 ? 1 : 0x41)});
+  for (unsigned char b : {0x2f, 0x2e, 0x5e, 0x5d})
+  {
+    stream.push_back({0x90, b, 0x7f});
+    stream.push_back({0x90, b, 0x00});
+  }
+  return stream;
+}
+
+static void Print(const char* scenario, int iterations, int events,
+                  double total)
+{
+  printf("{\"scenario\":\"%s\",\"iterations\":%d,\"events\":%d,"
+         "\"total_us\":%.0f,\"event_avg_ns\":%.2f}\n",
+         scenario, iterations, events, total * 1e6,
+         total * 1e9 / iterations / (events ? events : 1));
+}
+
+template <class F>
+static void Dispatch(const char* scenario, Surface& surface,
+                     const std::vector<std::vector<unsigned char>>& stream,
+                     int iterations, F dispatch)
+{
+  MIDI_event_t evt{};
+  evt.size = 3;
+  double t0 = Now();
+  for (int i = 0; i < iterations; i++)
+  {
+    for (auto& msg : stream)
+    {
+      memcpy(evt.midi_message, msg.data(), 3);
+      (surface.*dispatch)(&evt);
+    }
+  }
+  Print(scenario, iterations, (int)stream.size(), Now() - t0);
+}
+
+int main(int argc, char** argv)
+{
+  int iterations = argc > 1 && !strcmp(argv[1], "--quick") ? 100 : 10000;
+
+  Surface surface;
+  for (int i = 0; i < 0x20; i++)
+    surface.m_press_only_buttons[i] = 1;
+  surface.m_buttons_passthrough[0x5e] = 1;
+  surface.BuildButtonRoutes();
+  auto stream = RecordedStream();
+
+  Dispatch("dispatch_routes", surface, stream, iterations,
+           &Surface::OnMIDIEvent);
+  Dispatch("dispatch_scan", surface, stream, iterations,
+           &Surface::OnMIDIEventScan);
+
+  double t0 = Now();
+  for (int i = 0; i < iterations; i++)
+  {
+    surface.m_button_remap[0x5b] = i & 1 ? 0x5c : 0;
+    surface.BuildButtonRoutes();
+  }
+  Print("rebuild_routes", iterations, 0, Now() - t0);
+
+  // keeps handlers from being optimized out
+  int calls = 0;
+  for (int c : surface.m_calls)
+    calls += c;
+  return calls > 0 ? 0 : 1;
+}
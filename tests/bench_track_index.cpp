@@ -0,0 +1,103 @@
+// Track GUID lookup micro-benchmark: every track of a 10, 100 and 1000
+// track project looked up through TrackGUIDIndex and through the linear
+// GUID compare it replaced, plus the index rebuild after a track list
+// change. One JSON object per line.
+//
+//   bench_track_index [--quick]
+
+#include <reaper_plugin.h>
+
+#include "track_index.hpp"
+
+#include <chrono>
+#include <random>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+using namespace ReaMCULive;
+
+struct Track
+{
+  GUID guid;
+};
+
+static double Now()
+{
+  using namespace std::chrono;
+  return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+static Track* LinearFind(std::vector<Track>& tracks, const GUID& guid)
+{
+  for (auto& tr : tracks)
+  {
+    if (!memcmp(&tr.guid, &guid, sizeof(GUID)))
+      return &tr;
+  }
+  return NULL;
+}
+
+static void Rebuild(TrackGUIDIndex<Track>& index, std::vector<Track>& tracks,
+                    const void* proj)
+{
+  index.Clear();
+  for (auto& tr : tracks)
+    index.Add(tr.guid, &tr);
+  index.SetValid(proj);
+}
+
+static void Print(const char* scenario, int tracks, int iterations,
+                  double total)
+{
+  printf("{\"scenario\":\"%s\",\"tracks\":%d,\"iterations\":%d,"
+         "\"total_us\":%.0f,\"track_avg_ns\":%.2f}\n",
+         scenario, tracks, iterations, total * 1e6,
+         total * 1e9 / iterations / tracks);
+}
+
+int main(int argc, char** argv)
+{
+  int iterations = argc > 1 && !strcmp(argv[1], "--quick") ? 10 : 1000;
+  std::mt19937 rng(1);
+  int found = 0;
+
+  for (int n : {10, 100, 1000})
+  {
+    std::vector<Track> tracks(n);
+    for (auto& tr : tracks)
+    {
+      for (size_t i = 0; i < sizeof(GUID); i++)
+        ((unsigned char*)&tr.guid)[i] = (unsigned char)rng();
+    }
+
+    TrackGUIDIndex<Track> index;
+    double t0 = Now();
+    for (int i = 0; i < iterations; i++)
+    {
+      index.Invalidate();
+      if (!index.IsValid(&tracks))
+        Rebuild(index, tracks, &tracks);
+    }
+    Print("rebuild_index", n, iterations, Now() - t0);
+
+    t0 = Now();
+    for (int i = 0; i < iterations; i++)
+    {
+      for (auto& tr : tracks)
+        found += index.Find(tr.guid) == &tr;
+    }
+    Print("lookup_index", n, iterations, Now() - t0);
+
+    t0 = Now();
+    for (int i = 0; i < iterations; i++)
+    {
+      for (auto& tr : tracks)
+        found += LinearFind(tracks, tr.guid) == &tr;
+    }
+    Print("lookup_linear", n, iterations, Now() - t0);
+  }
+
+  // every lookup must hit its own track
+  return found == 2 * iterations * (10 + 100 + 1000) ? 0 : 1;
+}
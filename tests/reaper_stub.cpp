@@ -0,0 +1,1246 @@
+#include "reaper_stub.h"
+
+#include "reaper_plugin_functions.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <math.h>
+
+extern "C" int REAPER_PLUGIN_ENTRYPOINT(REAPER_PLUGIN_HINSTANCE hInstance,
+                                        reaper_plugin_info_t* rec);
+
+namespace ReaperStub
+{
+
+// swell_stub.cpp
+bool InitSWELL();
+bool WaitThreadsIdle(int msTO);
+
+// every REAPER function the plug-in uses, the rest resolve to
+// Stub_Unimplemented()
+#define STUB_APIS(X)                                                           \
+  X(CSurf_NumTracks)                                                           \
+  X(CSurf_OnArrow)                                                             \
+  X(CSurf_OnMuteChange)                                                        \
+  X(CSurf_OnPanChange)                                                         \
+  X(CSurf_OnRewFwd)                                                            \
+  X(CSurf_OnSelectedChange)                                                    \
+  X(CSurf_OnSendPanChange)                                                     \
+  X(CSurf_OnSendVolumeChange)                                                  \
+  X(CSurf_OnSoloChange)                                                        \
+  X(CSurf_OnVolumeChange)                                                      \
+  X(CSurf_ResetAllCachedVolPanStates)                                          \
+  X(CSurf_SetSurfaceMute)                                                      \
+  X(CSurf_SetSurfacePan)                                                       \
+  X(CSurf_SetSurfaceSolo)                                                      \
+  X(CSurf_SetSurfaceVolume)                                                    \
+  X(CSurf_TrackFromID)                                                         \
+  X(CSurf_TrackToID)                                                           \
+  X(CreateMIDIInput)                                                           \
+  X(CreateMIDIOutput)                                                          \
+  X(CreateTrackSend)                                                           \
+  X(DB2SLIDER)                                                                 \
+  X(EnumProjects)                                                              \
+  X(GetAppVersion)                                                             \
+  X(GetCursorPosition)                                                         \
+  X(GetMIDIInputName)                                                          \
+  X(GetMIDIOutputName)                                                         \
+  X(GetMasterTrack)                                                            \
+  X(GetMediaTrackInfo_Value)                                                   \
+  X(GetNumMIDIInputs)                                                          \
+  X(GetNumMIDIOutputs)                                                         \
+  X(GetNumTracks)                                                              \
+  X(GetPlayPosition)                                                           \
+  X(GetPlayState)                                                              \
+  X(GetProjExtState)                                                           \
+  X(GetSelectedTrack)                                                          \
+  X(GetSetMediaTrackInfo_String)                                               \
+  X(GetTrack)                                                                  \
+  X(GetTrackGUID)                                                              \
+  X(GetTrackName)                                                              \
+  X(GetTrackNumSends)                                                          \
+  X(GetTrackSendInfo_Value)                                                    \
+  X(GetTrackUIMute)                                                            \
+  X(GetTrackUIVolPan)                                                          \
+  X(IsTrackSelected)                                                           \
+  X(Main_OnCommand)                                                            \
+  X(SLIDER2DB)                                                                 \
+  X(SetOnlyTrackSelected)                                                      \
+  X(SetProjExtState)                                                           \
+  X(SetTrackSendInfo_Value)                                                    \
+  X(ShowConsoleMsg)                                                            \
+  X(SoloAllTracks)                                                             \
+  X(TimeMap2_timeToBeats)                                                      \
+  X(TrackList_UpdateAllExternalSurfaces)                                       \
+  X(Track_GetPeakInfo)                                                         \
+  X(format_timestr_pos)                                                        \
+  X(get_config_var)                                                            \
+  X(guidToString)                                                              \
+  X(kbd_OnMidiEvent)                                                           \
+  X(plugin_register)                                                           \
+  X(projectconfig_var_addr)                                                    \
+  X(projectconfig_var_getoffs)                                                 \
+  X(realloc_cmd_ptr)                                                           \
+  X(stringToGuid)                                                              \
+  X(time_precise)
+
+enum
+{
+#define STUB_ENUM(name) API_##name,
+  STUB_APIS(STUB_ENUM)
+#undef STUB_ENUM
+    API_UNIMPLEMENTED,
+  API_COUNT
+};
+
+static const char* g_api_names[API_COUNT] = {
+#define STUB_NAME(name) #name,
+  STUB_APIS(STUB_NAME)
+#undef STUB_NAME
+    "(unimplemented)",
+};
+
+// time_precise() is also called from plug-in threads
+static std::atomic<uint64_t> g_calls[API_COUNT];
+#define COUNT(name) g_calls[API_##name].fetch_add(1, std::memory_order_relaxed)
+
+/*
+** project model
+*/
+
+static std::vector<std::unique_ptr<Track>> g_tracks;
+static Track g_master;
+static std::vector<IReaperControlSurface*> g_surfaces;
+static int g_playstate;
+static std::vector<std::vector<unsigned char>> g_action_midi;
+static std::string g_console;
+static std::map<std::string, std::string> g_extstate;
+static char g_project; // ReaProject* of EnumProjects()
+
+static int g_config_csurfrate = 30;
+static int g_config_zoommode;
+static int g_config_vuminvol = -60;
+static int g_config_vumaxvol = 6;
+static int g_config_vudecay = 20;
+
+// projectconfig_var_getoffs() offset is index into this
+static double g_projectconfig[8];
+static const struct
+{
+  const char* name;
+  int size;
+} g_projectconfig_vars[] = {
+  {"", 0},
+  {"projtimemode", sizeof(int)},
+  {"projtimemode2", sizeof(int)},
+  {"projtimeoffs", sizeof(double)},
+  {"projmeasoffs", sizeof(int)},
+  {"projshowgrid", sizeof(int)},
+  {"autoxfade", sizeof(int)},
+  {"projmetroen", sizeof(int)},
+};
+
+static std::map<std::string, void*> g_plugin_api;
+static std::vector<reaper_csurf_reg_t*> g_csurf_regs;
+
+static Track* GetTrackByID(int id)
+{
+  if (id == 0)
+    return &g_master;
+  if (id < 1 || id > (int)g_tracks.size())
+    return NULL;
+  return g_tracks[id - 1].get();
+}
+
+static void InitTrack(Track* tr, int id)
+{
+  memset(&tr->guid, 0, sizeof(tr->guid));
+  tr->guid.Data1 = 0x5eed0000 + id;
+  tr->guid.Data4[7] = (unsigned char)id;
+  tr->id = id;
+  tr->name = id ? "" : "MASTER"; // unnamed like new REAPER tracks
+  tr->vol = 1.0;
+  tr->pan = 0.0;
+  tr->mute = tr->solo = tr->selected = tr->recarm = false;
+  tr->peak = 0.0;
+  tr->sends.clear();
+}
+
+/*
+** fake MIDI devices
+*/
+
+// packed MIDI_event_t records like REAPER's, 8 byte aligned
+class FakeMIDIEventList : public MIDI_eventlist
+{
+public:
+  virtual ~FakeMIDIEventList()
+  {
+  }
+
+  void AddItem(MIDI_event_t* evt)
+  {
+    size_t len = offsetof(MIDI_event_t, midi_message) +
+                 std::max(evt->size, (int)sizeof(evt->midi_message));
+    len = (len + 7) & ~(size_t)7;
+    size_t pos = m_buf.size();
+    m_buf.resize(pos + len);
+    memcpy(&m_buf[pos], evt,
+           offsetof(MIDI_event_t, midi_message) + std::max(evt->size, 0));
+  }
+
+  MIDI_event_t* EnumItems(int* bpos)
+  {
+    if (!bpos || *bpos < 0 || *bpos >= (int)m_buf.size())
+      return NULL;
+    auto evt = (MIDI_event_t*)&m_buf[*bpos];
+    size_t len = offsetof(MIDI_event_t, midi_message) +
+                 std::max(evt->size, (int)sizeof(evt->midi_message));
+    *bpos += (int)((len + 7) & ~(size_t)7);
+    return evt;
+  }
+
+  void DeleteItem(int bpos)
+  {
+    int next = bpos;
+    if (EnumItems(&next))
+      m_buf.erase(m_buf.begin() + bpos, m_buf.begin() + next);
+  }
+
+  int GetSize()
+  {
+    return (int)m_buf.size();
+  }
+
+  void Empty()
+  {
+    m_buf.clear();
+  }
+
+  void Swap(FakeMIDIEventList& other)
+  {
+    m_buf.swap(other.m_buf);
+  }
+
+private:
+  std::vector<unsigned char> m_buf;
+};
+
+class FakeMIDIInput;
+static std::mutex g_input_mutex;
+static std::map<int, FakeMIDIInput*> g_inputs;
+
+class FakeMIDIInput : public midi_Input
+{
+public:
+  FakeMIDIInput(int dev) : m_dev(dev)
+  {
+    std::lock_guard<std::mutex> lock(g_input_mutex);
+    g_inputs[dev] = this;
+  }
+
+  virtual ~FakeMIDIInput()
+  {
+    std::lock_guard<std::mutex> lock(g_input_mutex);
+    if (g_inputs[m_dev] == this)
+      g_inputs.erase(m_dev);
+  }
+
+  void start()
+  {
+  }
+
+  void stop()
+  {
+  }
+
+  void SwapBufs(unsigned int timestamp)
+  {
+    SwapBufsPrecise(timestamp, 0.0);
+  }
+
+  void SwapBufsPrecise(unsigned int coarsetimestamp, double precisetimestamp)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_read.Empty();
+    m_read.Swap(m_pending);
+  }
+
+  MIDI_eventlist* GetReadBuf()
+  {
+    return &m_read;
+  }
+
+  void Add(MIDI_event_t* evt)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_pending.AddItem(evt);
+  }
+
+private:
+  int m_dev;
+  std::mutex m_mutex;
+  FakeMIDIEventList m_pending;
+  FakeMIDIEventList m_read; // reader only
+};
+
+// written by plug-in's MIDI output threads
+static std::mutex g_output_mutex;
+static std::map<int, std::vector<std::vector<unsigned char>>> g_output;
+static uint64_t g_output_messages;
+static uint64_t g_output_bytes;
+
+class FakeMIDIOutput : public midi_Output
+{
+public:
+  FakeMIDIOutput(int dev) : m_dev(dev)
+  {
+  }
+
+  void SendMsg(MIDI_event_t* msg, int frame_offset)
+  {
+    if (!msg || msg->size < 1)
+      return;
+    std::lock_guard<std::mutex> lock(g_output_mutex);
+    g_output[m_dev].emplace_back(msg->midi_message,
+                                 msg->midi_message + msg->size);
+    g_output_messages++;
+    g_output_bytes += msg->size;
+  }
+
+  void Send(unsigned char status, unsigned char d1, unsigned char d2,
+            int frame_offset)
+  {
+    MIDI_event_t evt = {0, 3, {status, d1, d2}};
+    SendMsg(&evt, frame_offset);
+  }
+
+private:
+  int m_dev;
+};
+
+/*
+** REAPER API
+*/
+
+static int Stub_CSurf_NumTracks(bool mcpView)
+{
+  COUNT(CSurf_NumTracks);
+  return (int)g_tracks.size();
+}
+
+static void Stub_CSurf_OnArrow(int whichdir, bool wantzoom)
+{
+  COUNT(CSurf_OnArrow);
+}
+
+static void Stub_CSurf_SetSurfaceMute(MediaTrack* trackid, bool mute,
+                                      IReaperControlSurface* ignoresurf)
+{
+  COUNT(CSurf_SetSurfaceMute);
+  for (auto surf : g_surfaces)
+  {
+    if (surf != ignoresurf)
+      surf->SetSurfaceMute(trackid, mute);
+  }
+}
+
+static void Stub_CSurf_SetSurfacePan(MediaTrack* trackid, double pan,
+                                     IReaperControlSurface* ignoresurf)
+{
+  COUNT(CSurf_SetSurfacePan);
+  for (auto surf : g_surfaces)
+  {
+    if (surf != ignoresurf)
+      surf->SetSurfacePan(trackid, pan);
+  }
+}
+
+static void Stub_CSurf_SetSurfaceSolo(MediaTrack* trackid, bool solo,
+                                      IReaperControlSurface* ignoresurf)
+{
+  COUNT(CSurf_SetSurfaceSolo);
+  for (auto surf : g_surfaces)
+  {
+    if (surf != ignoresurf)
+      surf->SetSurfaceSolo(trackid, solo);
+  }
+}
+
+static void Stub_CSurf_SetSurfaceVolume(MediaTrack* trackid, double volume,
+                                        IReaperControlSurface* ignoresurf)
+{
+  COUNT(CSurf_SetSurfaceVolume);
+  for (auto surf : g_surfaces)
+  {
+    if (surf != ignoresurf)
+      surf->SetSurfaceVolume(trackid, volume);
+  }
+}
+
+static bool Stub_CSurf_OnMuteChange(MediaTrack* trackid, int mute)
+{
+  COUNT(CSurf_OnMuteChange);
+  Track* tr = FromMediaTrack(trackid);
+  if (!tr)
+    return false;
+  tr->mute = mute < 0 ? !tr->mute : !!mute;
+  for (auto surf : g_surfaces)
+    surf->SetSurfaceMute(trackid, tr->mute);
+  return tr->mute;
+}
+
+static double Stub_CSurf_OnPanChange(MediaTrack* trackid, double pan,
+                                     bool relative)
+{
+  COUNT(CSurf_OnPanChange);
+  Track* tr = FromMediaTrack(trackid);
+  if (!tr)
+    return 0.0;
+  tr->pan = std::min(std::max(relative ? tr->pan + pan : pan, -1.0), 1.0);
+  for (auto surf : g_surfaces)
+    surf->SetSurfacePan(trackid, tr->pan);
+  return tr->pan;
+}
+
+static void Stub_CSurf_OnRewFwd(int seekplay, int dir)
+{
+  COUNT(CSurf_OnRewFwd);
+}
+
+static bool Stub_CSurf_OnSelectedChange(MediaTrack* trackid, int selected)
+{
+  COUNT(CSurf_OnSelectedChange);
+  Track* tr = FromMediaTrack(trackid);
+  if (!tr)
+    return false;
+  tr->selected = selected < 0 ? !tr->selected : !!selected;
+  for (auto surf : g_surfaces)
+    surf->SetSurfaceSelected(trackid, tr->selected);
+  return tr->selected;
+}
+
+static double Stub_CSurf_OnSendPanChange(MediaTrack* trackid, int send_index,
+                                         double pan, bool relative)
+{
+  COUNT(CSurf_OnSendPanChange);
+  Track* tr = FromMediaTrack(trackid);
+  if (!tr || send_index < 0 || send_index >= (int)tr->sends.size())
+    return 0.0;
+  Send& s = tr->sends[send_index];
+  s.pan = std::min(std::max(relative ? s.pan + pan : pan, -1.0), 1.0);
+  return s.pan;
+}
+
+static double Stub_CSurf_OnSendVolumeChange(MediaTrack* trackid,
+                                            int send_index, double volume,
+                                            bool relative)
+{
+  COUNT(CSurf_OnSendVolumeChange);
+  Track* tr = FromMediaTrack(trackid);
+  if (!tr || send_index < 0 || send_index >= (int)tr->sends.size())
+    return 0.0;
+  Send& s = tr->sends[send_index];
+  s.vol = std::max(relative ? s.vol + volume : volume, 0.0);
+  return s.vol;
+}
+
+static bool Stub_CSurf_OnSoloChange(MediaTrack* trackid, int solo)
+{
+  COUNT(CSurf_OnSoloChange);
+  Track* tr = FromMediaTrack(trackid);
+  if (!tr)
+    return false;
+  tr->solo = solo < 0 ? !tr->solo : !!solo;
+  for (auto surf : g_surfaces)
+    surf->SetSurfaceSolo(trackid, tr->solo);
+  return tr->solo;
+}
+
+static double Stub_CSurf_OnVolumeChange(MediaTrack* trackid, double volume,
+                                        bool relative)
+{
+  COUNT(CSurf_OnVolumeChange);
+  Track* tr = FromMediaTrack(trackid);
+  if (!tr)
+    return 0.0;
+  tr->vol = std::max(relative ? tr->vol + volume : volume, 0.0);
+  for (auto surf : g_surfaces)
+    surf->SetSurfaceVolume(trackid, tr->vol);
+  return tr->vol;
+}
+
+static void Stub_CSurf_ResetAllCachedVolPanStates()
+{
+  COUNT(CSurf_ResetAllCachedVolPanStates);
+}
+
+static MediaTrack* Stub_CSurf_TrackFromID(int idx, bool mcpView)
+{
+  COUNT(CSurf_TrackFromID);
+  return ToMediaTrack(GetTrackByID(idx));
+}
+
+static int Stub_CSurf_TrackToID(MediaTrack* track, bool mcpView)
+{
+  COUNT(CSurf_TrackToID);
+  return track ? FromMediaTrack(track)->id : -1;
+}
+
+static midi_Input* Stub_CreateMIDIInput(int dev)
+{
+  COUNT(CreateMIDIInput);
+  return new FakeMIDIInput(dev);
+}
+
+static midi_Output* Stub_CreateMIDIOutput(int dev, bool streamMode,
+                                          int* msoffset100)
+{
+  COUNT(CreateMIDIOutput);
+  return new FakeMIDIOutput(dev);
+}
+
+static int Stub_CreateTrackSend(MediaTrack* tr, MediaTrack* desttrInOptional)
+{
+  COUNT(CreateTrackSend);
+  if (!tr)
+    return -1;
+  FromMediaTrack(tr)->sends.push_back({desttrInOptional, 1.0, 0.0, false});
+  return (int)FromMediaTrack(tr)->sends.size() - 1;
+}
+
+// Monotonic stand-in for REAPER's fader taper, slider 0..1000 is -190..+12
+// dB so -150 dB (VAL2DB floor) is above slider 0 like on a real taper.
+static double Stub_DB2SLIDER(double x)
+{
+  COUNT(DB2SLIDER);
+  if (x <= -190.0)
+    return 0.0;
+  return 1000.0 * pow((x + 190.0) / 202.0, 4.0);
+}
+
+static double Stub_SLIDER2DB(double y)
+{
+  COUNT(SLIDER2DB);
+  if (y <= 0.0)
+    return -190.0;
+  return 202.0 * pow(y / 1000.0, 0.25) - 190.0;
+}
+
+static ReaProject* Stub_EnumProjects(int idx, char* projfnOutOptional,
+                                     int projfnOutOptional_sz)
+{
+  COUNT(EnumProjects);
+  if (projfnOutOptional && projfnOutOptional_sz > 0)
+    *projfnOutOptional = 0;
+  return idx <= 0 ? (ReaProject*)&g_project : NULL;
+}
+
+static const char* Stub_GetAppVersion()
+{
+  COUNT(GetAppVersion);
+  return "7.0/stub";
+}
+
+static double Stub_GetCursorPosition()
+{
+  COUNT(GetCursorPosition);
+  return 0.0;
+}
+
+static bool Stub_GetMIDIInputName(int dev, char* nameout, int nameout_sz)
+{
+  COUNT(GetMIDIInputName);
+  snprintf(nameout, nameout_sz, "Fake MIDI In %d", dev);
+  return true;
+}
+
+static bool Stub_GetMIDIOutputName(int dev, char* nameout, int nameout_sz)
+{
+  COUNT(GetMIDIOutputName);
+  snprintf(nameout, nameout_sz, "Fake MIDI Out %d", dev);
+  return true;
+}
+
+static MediaTrack* Stub_GetMasterTrack(ReaProject* proj)
+{
+  COUNT(GetMasterTrack);
+  return ToMediaTrack(&g_master);
+}
+
+static double Stub_GetMediaTrackInfo_Value(MediaTrack* tr,
+                                           const char* parmname)
+{
+  COUNT(GetMediaTrackInfo_Value);
+  Track* t = FromMediaTrack(tr);
+  if (!t || !parmname)
+    return 0.0;
+  if (!strcmp(parmname, "D_VOL"))
+    return t->vol;
+  if (!strcmp(parmname, "D_PAN"))
+    return t->pan;
+  if (!strcmp(parmname, "B_MUTE"))
+    return t->mute;
+  if (!strcmp(parmname, "I_SOLO"))
+    return t->solo;
+  if (!strcmp(parmname, "I_SELECTED"))
+    return t->selected;
+  if (!strcmp(parmname, "I_RECARM"))
+    return t->recarm;
+  if (!strcmp(parmname, "IP_TRACKNUMBER"))
+    return t->id ? t->id : -1;
+  return 0.0;
+}
+
+static int Stub_GetNumMIDIInputs()
+{
+  COUNT(GetNumMIDIInputs);
+  return 16;
+}
+
+static int Stub_GetNumMIDIOutputs()
+{
+  COUNT(GetNumMIDIOutputs);
+  return 16;
+}
+
+static int Stub_GetNumTracks()
+{
+  COUNT(GetNumTracks);
+  return (int)g_tracks.size();
+}
+
+static double Stub_GetPlayPosition()
+{
+  COUNT(GetPlayPosition);
+  return 0.0;
+}
+
+static int Stub_GetPlayState()
+{
+  COUNT(GetPlayState);
+  return g_playstate;
+}
+
+static int Stub_GetProjExtState(ReaProject* proj, const char* extname,
+                                const char* key, char* valOutNeedBig,
+                                int valOutNeedBig_sz)
+{
+  COUNT(GetProjExtState);
+  auto it = g_extstate.find(std::string(extname) + "/" + key);
+  if (valOutNeedBig && valOutNeedBig_sz > 0)
+  {
+    snprintf(valOutNeedBig, valOutNeedBig_sz, "%s",
+             it != g_extstate.end() ? it->second.c_str() : "");
+  }
+  return it != g_extstate.end() ? (int)it->second.size() : 0;
+}
+
+static MediaTrack* Stub_GetSelectedTrack(ReaProject* proj, int seltrackidx)
+{
+  COUNT(GetSelectedTrack);
+  for (auto& tr : g_tracks)
+  {
+    if (tr->selected && !seltrackidx--)
+      return ToMediaTrack(tr.get());
+  }
+  return NULL;
+}
+
+static bool Stub_GetSetMediaTrackInfo_String(MediaTrack* tr,
+                                             const char* parmname,
+                                             char* stringNeedBig,
+                                             bool setNewValue)
+{
+  COUNT(GetSetMediaTrackInfo_String);
+  Track* t = FromMediaTrack(tr);
+  if (!t || strcmp(parmname, "P_NAME"))
+    return false;
+  if (setNewValue)
+    t->name = stringNeedBig;
+  else
+    strcpy(stringNeedBig, t->name.c_str()); // NeedBig: caller has 4096
+  return true;
+}
+
+static MediaTrack* Stub_GetTrack(ReaProject* proj, int trackidx)
+{
+  COUNT(GetTrack);
+  return ToMediaTrack(GetTrackByID(trackidx + 1));
+}
+
+static GUID* Stub_GetTrackGUID(MediaTrack* tr)
+{
+  COUNT(GetTrackGUID);
+  return tr ? &FromMediaTrack(tr)->guid : NULL;
+}
+
+static bool Stub_GetTrackName(MediaTrack* track, char* bufOut, int bufOut_sz)
+{
+  COUNT(GetTrackName);
+  if (!track)
+    return false;
+  Track* tr = FromMediaTrack(track);
+  if (tr->name.empty())
+    snprintf(bufOut, bufOut_sz, "Track %d", tr->id);
+  else
+    snprintf(bufOut, bufOut_sz, "%s", tr->name.c_str());
+  return true;
+}
+
+static int Stub_GetTrackNumSends(MediaTrack* tr, int category)
+{
+  COUNT(GetTrackNumSends);
+  return tr && category == 0 ? (int)FromMediaTrack(tr)->sends.size() : 0;
+}
+
+static double Stub_GetTrackSendInfo_Value(MediaTrack* tr, int category,
+                                          int sendidx, const char* parmname)
+{
+  COUNT(GetTrackSendInfo_Value);
+  Track* t = FromMediaTrack(tr);
+  if (!t || category != 0 || sendidx < 0 || sendidx >= (int)t->sends.size())
+    return 0.0;
+  const Send& s = t->sends[sendidx];
+  if (!strcmp(parmname, "P_DESTTRACK"))
+    return (double)(uintptr_t)s.dst;
+  if (!strcmp(parmname, "D_VOL"))
+    return s.vol;
+  if (!strcmp(parmname, "D_PAN"))
+    return s.pan;
+  if (!strcmp(parmname, "B_MUTE"))
+    return s.mute;
+  return 0.0;
+}
+
+static bool Stub_GetTrackUIMute(MediaTrack* track, bool* muteOut)
+{
+  COUNT(GetTrackUIMute);
+  if (!track)
+    return false;
+  *muteOut = FromMediaTrack(track)->mute;
+  return true;
+}
+
+static bool Stub_GetTrackUIVolPan(MediaTrack* track, double* volumeOut,
+                                  double* panOut)
+{
+  COUNT(GetTrackUIVolPan);
+  if (!track)
+    return false;
+  *volumeOut = FromMediaTrack(track)->vol;
+  *panOut = FromMediaTrack(track)->pan;
+  return true;
+}
+
+static bool Stub_IsTrackSelected(MediaTrack* track)
+{
+  COUNT(IsTrackSelected);
+  return track && FromMediaTrack(track)->selected;
+}
+
+static void Stub_Main_OnCommand(int command, int flag)
+{
+  COUNT(Main_OnCommand);
+}
+
+static void Stub_SetOnlyTrackSelected(MediaTrack* track)
+{
+  COUNT(SetOnlyTrackSelected);
+  for (auto& tr : g_tracks)
+  {
+    bool sel = ToMediaTrack(tr.get()) == track;
+    if (tr->selected == sel)
+      continue;
+    tr->selected = sel;
+    for (auto surf : g_surfaces)
+      surf->SetSurfaceSelected(ToMediaTrack(tr.get()), sel);
+  }
+}
+
+static int Stub_SetProjExtState(ReaProject* proj, const char* extname,
+                                const char* key, const char* value)
+{
+  COUNT(SetProjExtState);
+  g_extstate[std::string(extname) + "/" + (key ? key : "")] =
+    value ? value : "";
+  return 1;
+}
+
+static bool Stub_SetTrackSendInfo_Value(MediaTrack* tr, int category,
+                                        int sendidx, const char* parmname,
+                                        double newvalue)
+{
+  COUNT(SetTrackSendInfo_Value);
+  Track* t = FromMediaTrack(tr);
+  if (!t || category != 0 || sendidx < 0 || sendidx >= (int)t->sends.size())
+    return false;
+  Send& s = t->sends[sendidx];
+  if (!strcmp(parmname, "P_DESTTRACK"))
+    s.dst = (MediaTrack*)(uintptr_t)newvalue;
+  else if (!strcmp(parmname, "D_VOL"))
+    s.vol = newvalue;
+  else if (!strcmp(parmname, "D_PAN"))
+    s.pan = newvalue;
+  else if (!strcmp(parmname, "B_MUTE"))
+    s.mute = newvalue != 0.0;
+  else
+    return false;
+  return true;
+}
+
+static void Stub_ShowConsoleMsg(const char* msg)
+{
+  COUNT(ShowConsoleMsg);
+  g_console += msg;
+}
+
+static void Stub_SoloAllTracks(int solo)
+{
+  COUNT(SoloAllTracks);
+  for (auto& tr : g_tracks)
+    tr->solo = !!solo;
+}
+
+static double Stub_TimeMap2_timeToBeats(ReaProject* proj, double tpos,
+                                        int* measuresOutOptional,
+                                        int* cmlOutOptional,
+                                        double* fullbeatsOutOptional,
+                                        int* cdenomOutOptional)
+{
+  COUNT(TimeMap2_timeToBeats);
+  double beats = tpos * 2.0; // 120 bpm 4/4
+  if (measuresOutOptional)
+    *measuresOutOptional = (int)(beats / 4.0);
+  if (cmlOutOptional)
+    *cmlOutOptional = 4;
+  if (fullbeatsOutOptional)
+    *fullbeatsOutOptional = beats;
+  if (cdenomOutOptional)
+    *cdenomOutOptional = 4;
+  return fmod(beats, 4.0);
+}
+
+static void Stub_TrackList_UpdateAllExternalSurfaces()
+{
+  COUNT(TrackList_UpdateAllExternalSurfaces);
+  UpdateAllSurfaces();
+}
+
+static double Stub_Track_GetPeakInfo(MediaTrack* track, int channel)
+{
+  COUNT(Track_GetPeakInfo);
+  return track ? FromMediaTrack(track)->peak : 0.0;
+}
+
+static void Stub_format_timestr_pos(double tpos, char* buf, int buf_sz,
+                                    int modeoverride)
+{
+  COUNT(format_timestr_pos);
+  snprintf(buf, buf_sz, "%d:%06.3f", (int)(tpos / 60.0), fmod(tpos, 60.0));
+}
+
+static void* Stub_get_config_var(const char* name, int* szOut)
+{
+  COUNT(get_config_var);
+  static const struct
+  {
+    const char* name;
+    int* var;
+  } vars[] = {
+    {"csurfrate", &g_config_csurfrate}, {"zoommode", &g_config_zoommode},
+    {"vuminvol", &g_config_vuminvol},   {"vumaxvol", &g_config_vumaxvol},
+    {"vudecay", &g_config_vudecay},
+  };
+  for (auto& v : vars)
+  {
+    if (!strcmp(v.name, name))
+    {
+      if (szOut)
+        *szOut = sizeof(int);
+      return v.var;
+    }
+  }
+  return NULL;
+}
+
+static void Stub_guidToString(const GUID* g, char* destNeed64)
+{
+  COUNT(guidToString);
+  snprintf(destNeed64, 64,
+           "{%08X-%04X-%04X-%02X%02X-%02X%02X%02X%02X%02X%02X}",
+           (unsigned)g->Data1, g->Data2, g->Data3, g->Data4[0], g->Data4[1],
+           g->Data4[2], g->Data4[3], g->Data4[4], g->Data4[5], g->Data4[6],
+           g->Data4[7]);
+}
+
+static void Stub_kbd_OnMidiEvent(MIDI_event_t* evt, int dev_index)
+{
+  COUNT(kbd_OnMidiEvent);
+  g_action_midi.emplace_back(evt->midi_message,
+                             evt->midi_message + evt->size);
+}
+
+static int Stub_plugin_register(const char* name, void* infostruct)
+{
+  COUNT(plugin_register);
+  if (!strncmp(name, "API_", 4))
+    g_plugin_api[name + 4] = infostruct;
+  else if (!strcmp(name, "csurf"))
+    g_csurf_regs.push_back((reaper_csurf_reg_t*)infostruct);
+  return 1;
+}
+
+static void* Stub_projectconfig_var_addr(ReaProject* proj, int idx)
+{
+  COUNT(projectconfig_var_addr);
+  if (idx < 1 || idx >= (int)(sizeof(g_projectconfig) /
+                               sizeof(g_projectconfig[0])))
+    return NULL;
+  return &g_projectconfig[idx];
+}
+
+static int Stub_projectconfig_var_getoffs(const char* name, int* szOut)
+{
+  COUNT(projectconfig_var_getoffs);
+  for (int i = 1; i < (int)(sizeof(g_projectconfig_vars) /
+                            sizeof(g_projectconfig_vars[0]));
+       i++)
+  {
+    if (!strcmp(g_projectconfig_vars[i].name, name))
+    {
+      if (szOut)
+        *szOut = g_projectconfig_vars[i].size;
+      return i;
+    }
+  }
+  return 0;
+}
+
+// like REAPER, only the buffer of the ReaScript call can be resized
+static char* g_cmd_buf;
+static int g_cmd_buf_sz;
+
+static bool Stub_realloc_cmd_ptr(char** ptr, int* ptr_size, int new_size)
+{
+  COUNT(realloc_cmd_ptr);
+  if (!*ptr || *ptr != g_cmd_buf || new_size < 1)
+    return false;
+  char* p = (char*)realloc(g_cmd_buf, new_size);
+  if (!p)
+    return false;
+  *ptr = g_cmd_buf = p;
+  *ptr_size = g_cmd_buf_sz = new_size;
+  return true;
+}
+
+static void Stub_stringToGuid(const char* str, GUID* g)
+{
+  COUNT(stringToGuid);
+  unsigned int d[11] = {};
+  memset(g, 0, sizeof(*g));
+  if (sscanf(str, "{%8X-%4X-%4X-%2X%2X-%2X%2X%2X%2X%2X%2X}", &d[0], &d[1],
+             &d[2], &d[3], &d[4], &d[5], &d[6], &d[7], &d[8], &d[9],
+             &d[10]) != 11)
+    return;
+  g->Data1 = d[0];
+  g->Data2 = (unsigned short)d[1];
+  g->Data3 = (unsigned short)d[2];
+  for (int i = 0; i < 8; i++)
+    g->Data4[i] = (unsigned char)d[3 + i];
+}
+
+static double g_time_offset;
+
+static double Stub_time_precise()
+{
+  COUNT(time_precise);
+  return GetTime();
+}
+
+static int Stub_Unimplemented()
+{
+  COUNT(UNIMPLEMENTED);
+  return 0;
+}
+
+static void* GetFunc(const char* name)
+{
+  // fails the build if a stub does not match REAPER's prototype
+#define STUB_FUNC(fn)                                                          \
+  if (!strcmp(name, #fn))                                                      \
+    return (void*)static_cast<decltype(::fn)>(&Stub_##fn);
+  STUB_APIS(STUB_FUNC)
+#undef STUB_FUNC
+
+  if (!strncmp(name, "__localize", 10))
+    return NULL; // plug-in falls back to its own strings
+  return (void*)&Stub_Unimplemented;
+}
+
+/*
+** harness
+*/
+
+bool LoadPlugin()
+{
+  static int loaded = -1;
+  if (loaded >= 0)
+    return !!loaded;
+
+  InitTrack(&g_master, 0);
+  loaded = 0;
+  if (!InitSWELL())
+    return false;
+
+  reaper_plugin_info_t rec{};
+  rec.caller_version = REAPER_PLUGIN_VERSION;
+  rec.Register = &Stub_plugin_register;
+  rec.GetFunc = &GetFunc;
+  loaded = REAPER_PLUGIN_ENTRYPOINT(NULL, &rec) && g_csurf_regs.size() >= 2;
+  return !!loaded;
+}
+
+void* GetPluginAPI(const char* name)
+{
+  auto it = g_plugin_api.find(name);
+  return it != g_plugin_api.end() ? it->second : NULL;
+}
+
+IReaperControlSurface* CreateSurface(bool ex, int offset, int size,
+                                     int indev, int outdev, int flags)
+{
+  const char* type = ex ? "MCULIVEEX" : "MCULIVE";
+  for (auto reg : g_csurf_regs)
+  {
+    if (strcmp(reg->type_string, type))
+      continue;
+    char cfg[128];
+    snprintf(cfg, sizeof(cfg), "%d %d %d %d %d", offset, size, indev, outdev,
+             flags);
+    int err = 0;
+    IReaperControlSurface* surf = reg->create(type, cfg, &err);
+    if (surf)
+      g_surfaces.push_back(surf);
+    return surf;
+  }
+  return NULL;
+}
+
+void DestroySurfaces()
+{
+  // threaded outputs finish sending before they go
+  while (!g_surfaces.empty())
+  {
+    delete g_surfaces.back();
+    g_surfaces.pop_back();
+  }
+}
+
+int GetSurfaceCount()
+{
+  return (int)g_surfaces.size();
+}
+
+IReaperControlSurface* GetSurface(int idx)
+{
+  return idx >= 0 && idx < (int)g_surfaces.size() ? g_surfaces[idx] : NULL;
+}
+
+void SetTrackCount(int n)
+{
+  g_tracks.clear();
+  for (int i = 0; i < n; i++)
+  {
+    g_tracks.emplace_back(new Track);
+    InitTrack(g_tracks.back().get(), i + 1);
+  }
+  for (auto surf : g_surfaces)
+    surf->SetTrackListChange();
+}
+
+int GetTrackCount()
+{
+  return (int)g_tracks.size();
+}
+
+Track* GetTrack(int idx)
+{
+  return GetTrackByID(idx + 1);
+}
+
+Track* GetMaster()
+{
+  return &g_master;
+}
+
+void UpdateAllSurfaces()
+{
+  for (auto surf : g_surfaces)
+    surf->SetTrackListChange();
+  for (int id = 0; id <= (int)g_tracks.size(); id++)
+  {
+    Track* tr = GetTrackByID(id);
+    MediaTrack* mt = ToMediaTrack(tr);
+    for (auto surf : g_surfaces)
+    {
+      surf->SetSurfaceVolume(mt, tr->vol);
+      surf->SetSurfacePan(mt, tr->pan);
+      surf->SetSurfaceMute(mt, tr->mute);
+      surf->SetSurfaceSelected(mt, tr->selected);
+      surf->SetSurfaceSolo(mt, tr->solo);
+      surf->SetSurfaceRecArm(mt, tr->recarm);
+      surf->SetTrackTitle(mt, tr->name.c_str());
+    }
+  }
+  for (auto surf : g_surfaces)
+    surf->SetPlayState((g_playstate & 1) != 0, (g_playstate & 2) != 0,
+                       (g_playstate & 4) != 0);
+}
+
+void RunSurfaces()
+{
+  for (auto surf : g_surfaces)
+    surf->Run();
+}
+
+double GetTime()
+{
+  using namespace std::chrono;
+  return duration<double>(steady_clock::now().time_since_epoch()).count() +
+         g_time_offset;
+}
+
+void Advance(double seconds)
+{
+  g_time_offset += seconds;
+}
+
+midi_Output* CreateFakeMIDIOutput(int dev)
+{
+  return new FakeMIDIOutput(dev);
+}
+
+void SendInput(int dev, const unsigned char* msg, int len)
+{
+  struct
+  {
+    MIDI_event_t evt;
+    unsigned char data[1024];
+  } evt{};
+  if (len < 1 || len > (int)sizeof(evt.data))
+    return;
+  evt.evt.size = len;
+  memcpy(evt.evt.midi_message, msg, len);
+
+  std::lock_guard<std::mutex> lock(g_input_mutex);
+  auto it = g_inputs.find(dev);
+  if (it != g_inputs.end())
+    it->second->Add(&evt.evt);
+}
+
+char* GetCmdBuffer(int* sz)
+{
+  if (!g_cmd_buf)
+  {
+    g_cmd_buf = (char*)calloc(1, 1);
+    g_cmd_buf_sz = 1;
+  }
+  *sz = g_cmd_buf_sz;
+  return g_cmd_buf;
+}
+
+void WaitOutput()
+{
+  // sender threads wait without timeout only once their queues are empty
+  WaitThreadsIdle(5000);
+}
+
+std::vector<std::vector<unsigned char>> TakeOutput(int dev)
+{
+  std::lock_guard<std::mutex> lock(g_output_mutex);
+  std::vector<std::vector<unsigned char>> res;
+  res.swap(g_output[dev]);
+  return res;
+}
+
+void ClearOutput()
+{
+  std::lock_guard<std::mutex> lock(g_output_mutex);
+  g_output.clear();
+}
+
+uint64_t GetOutputMessages()
+{
+  std::lock_guard<std::mutex> lock(g_output_mutex);
+  return g_output_messages;
+}
+
+uint64_t GetOutputBytes()
+{
+  std::lock_guard<std::mutex> lock(g_output_mutex);
+  return g_output_bytes;
+}
+
+int GetAPICount()
+{
+  return API_COUNT;
+}
+
+const char* GetAPIName(int api)
+{
+  return api >= 0 && api < API_COUNT ? g_api_names[api] : "";
+}
+
+uint64_t GetAPICalls(int api)
+{
+  return api >= 0 && api < API_COUNT
+           ? g_calls[api].load(std::memory_order_relaxed)
+           : 0;
+}
+
+uint64_t GetAPICallsTotal()
+{
+  uint64_t n = 0;
+  for (int i = 0; i < API_COUNT; i++)
+  {
+    // plug-in threads keep calling time_precise(), not part of the work
+    if (i != API_time_precise)
+      n += g_calls[i].load(std::memory_order_relaxed);
+  }
+  return n;
+}
+
+void ResetCounters()
+{
+  for (auto& c : g_calls)
+    c.store(0, std::memory_order_relaxed);
+  std::lock_guard<std::mutex> lock(g_output_mutex);
+  g_output_messages = 0;
+  g_output_bytes = 0;
+}
+
+std::vector<std::vector<unsigned char>> TakeActionMIDI()
+{
+  std::vector<std::vector<unsigned char>> res;
+  res.swap(g_action_midi);
+  return res;
+}
+
+std::string TakeConsole()
+{
+  std::string res;
+  res.swap(g_console);
+  return res;
+}
+
+} // namespace ReaperStub
@@ -0,0 +1,115 @@
+#ifndef _REAPER_STUB_H_
+#define _REAPER_STUB_H_
+
+#include <reaper_plugin.h>
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Headless REAPER for tests and benchmarks: the plug-in is loaded through
+// its real entry point with every API function pointer resolved to the
+// stubs below, MIDI devices are in-memory fakes. Main thread only, except
+// MIDI output which the plug-in's sender threads write.
+namespace ReaperStub
+{
+
+struct Send
+{
+  MediaTrack* dst;
+  double vol;
+  double pan;
+  bool mute;
+};
+
+struct Track
+{
+  GUID guid;
+  std::string name;
+  int id; // CSurf_TrackToID(), 0 = master
+  double vol;
+  double pan;
+  bool mute;
+  bool solo;
+  bool selected;
+  bool recarm;
+  double peak; // Track_GetPeakInfo() of both channels
+  std::vector<Send> sends;
+};
+
+inline MediaTrack* ToMediaTrack(Track* tr)
+{
+  return (MediaTrack*)tr;
+}
+
+inline Track* FromMediaTrack(MediaTrack* tr)
+{
+  return (Track*)tr;
+}
+
+// Runs plug-in entry point, also sets up SWELL where used. Once per process.
+bool LoadPlugin();
+
+// API_* function registered by plug-in, e.g. "MCULive_SetDeviceOption"
+void* GetPluginAPI(const char* name);
+
+// Creates surface with its "offset size indev outdev flags" config, fake
+// MIDI devices are created on demand. ex = MCU extender.
+IReaperControlSurface* CreateSurface(bool ex, int offset, int size,
+                                     int indev, int outdev, int flags = 0);
+void DestroySurfaces();
+int GetSurfaceCount();
+IReaperControlSurface* GetSurface(int idx); // creation order
+
+// replaces project with n tracks, all surfaces get SetTrackListChange()
+void SetTrackCount(int n);
+int GetTrackCount();
+Track* GetTrack(int idx); // 0-based, master excluded
+Track* GetMaster();
+
+// REAPER's surface refresh: SetTrackListChange() and all track state to
+// every surface, like TrackList_UpdateAllExternalSurfaces
+void UpdateAllSurfaces();
+
+// Run() of every surface in creation order
+void RunSurfaces();
+
+// time_precise() is real time plus offset, Advance() jumps it forward
+double GetTime();
+void Advance(double seconds);
+
+// device dev as CreateMIDIOutput() returns it, output goes to TakeOutput()
+midi_Output* CreateFakeMIDIOutput(int dev);
+
+// MIDI from device dev, read by plug-in on its next input swap
+void SendInput(int dev, const unsigned char* msg, int len);
+
+// ReaScript's buffer for plug-in API "...OutNeedBig" arguments, plug-in
+// can grow it with realloc_cmd_ptr(). Get it again after the call.
+char* GetCmdBuffer(int* sz);
+
+// Waits until all surfaces' threaded outputs are idle
+void WaitOutput();
+
+// messages device dev received since previous take, oldest first
+std::vector<std::vector<unsigned char>> TakeOutput(int dev);
+void ClearOutput();
+
+// totals of all fake output devices since ResetCounters()
+uint64_t GetOutputMessages();
+uint64_t GetOutputBytes();
+
+// REAPER API calls made by plug-in since ResetCounters()
+int GetAPICount();
+const char* GetAPIName(int api);
+uint64_t GetAPICalls(int api);
+uint64_t GetAPICallsTotal();
+void ResetCounters();
+
+// what plug-in passed to REAPER since previous take
+std::vector<std::vector<unsigned char>> TakeActionMIDI(); // kbd_OnMidiEvent()
+std::string TakeConsole(); // ShowConsoleMsg()
+
+} // namespace ReaperStub
+
+#endif
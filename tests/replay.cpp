@@ -0,0 +1,105 @@
+// Offline replay of a trace written by MCULive_DumpTrace: input messages
+// are fed with their recorded timing to a headless MCU on stubbed REAPER,
+// and what it sends back is printed.
+//
+//   reamculive_replay [--tracks n] trace
+//
+// Output is the session format of tests/data/mcu_session.txt, seconds from
+// first input then message bytes in hex. Replayed output follows each input
+// as "# out" comment. SysEx input is stored truncated and is skipped.
+
+#include "reaper_stub.h"
+
+#include "surface_trace.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+using namespace ReaMCULive;
+using namespace ReaperStub;
+
+static void Print(const char* prefix, double time, const unsigned char* msg,
+                  int len)
+{
+  printf("%s%.3f", prefix, time);
+  for (int i = 0; i < len; i++)
+    printf(" %02x", msg[i]);
+  printf("\n");
+}
+
+static void PrintOutput(double time)
+{
+  WaitOutput();
+  for (auto& m : TakeOutput(0))
+    Print("# out ", time, m.data(), (int)m.size());
+}
+
+int main(int argc, char** argv)
+{
+  int tracks = 16;
+  const char* fn = NULL;
+  bool usage = false;
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "--tracks") && i + 1 < argc)
+      tracks = atoi(argv[++i]);
+    else if (argv[i][0] != '-' && !fn)
+      fn = argv[i];
+    else
+      usage = true;
+  }
+  if (usage || !fn || tracks < 0)
+  {
+    fprintf(stderr, "usage: %s [--tracks n] trace\n", argv[0]);
+    return 1;
+  }
+
+  std::vector<TraceRecord> records;
+  FILE* fp = fopen(fn, "rb");
+  bool ok = fp && SurfaceTrace::Read(fp, &records);
+  if (fp)
+    fclose(fp);
+  if (!ok)
+  {
+    fprintf(stderr, "%s: not a trace file\n", fn);
+    return 1;
+  }
+  if (!LoadPlugin())
+    return 1;
+
+  SetTrackCount(tracks);
+  CreateSurface(false, 0, 8, 0, 0);
+  UpdateAllSurfaces();
+  RunSurfaces();
+  WaitOutput();
+  ClearOutput();
+
+  int replayed = 0, skipped = 0;
+  double start = 0.0, last = 0.0;
+  for (auto& rec : records)
+  {
+    if (rec.type != TRACE_IN)
+      continue;
+    if (rec.size < 1 || rec.size > 4)
+    {
+      skipped++;
+      continue;
+    }
+    if (!replayed)
+      start = last = rec.time;
+    Advance(rec.time - last);
+    last = rec.time;
+
+    Print("", rec.time - start, rec.msg, rec.size);
+    SendInput(0, rec.msg, rec.size);
+    RunSurfaces();
+    PrintOutput(rec.time - start);
+    replayed++;
+  }
+
+  printf("# %d messages replayed, %d skipped\n", replayed, skipped);
+  DestroySurfaces();
+  return 0;
+}
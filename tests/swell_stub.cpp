@@ -0,0 +1,220 @@
+// SWELL functions the plug-in uses without REAPER around: events, threads
+// and Sleep() on top of the C++ runtime. Windows uses the real API.
+
+#ifdef _WIN32
+
+#include <windows.h>
+
+namespace ReaperStub
+{
+
+bool InitSWELL()
+{
+  return true;
+}
+
+// real threads can't be observed, give them time instead
+bool WaitThreadsIdle(int msTO)
+{
+  Sleep(msTO < 20 ? msTO : 20);
+  return true;
+}
+
+} // namespace ReaperStub
+
+#else
+
+#include "../WDL/swell/swell.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string.h>
+#include <thread>
+
+extern "C" int SWELL_dllMain(HINSTANCE hInst, DWORD callMode, LPVOID _GetFunc);
+
+namespace ReaperStub
+{
+
+// All shim objects share one lock so WaitThreadsIdle() sees a consistent
+// count. A shim thread is idle while sleeping or blocked without timeout on
+// an unsignaled object, SetEvent() makes its waiters busy again before it
+// returns.
+static std::mutex g_mutex;
+static std::condition_variable g_idle_cond;
+static int g_threads; // shim threads not yet returned
+static int g_idle;    // of those, idle
+static thread_local bool t_shim_thread;
+
+// event, or thread which is signaled once it returns
+struct ShimObject
+{
+  std::condition_variable cond;
+  bool signaled{false};
+  bool manual_reset{true};
+  int idle_waiters{0};
+  std::thread thread;
+};
+
+// g_mutex held
+static void Signal(ShimObject* obj)
+{
+  obj->signaled = true;
+  g_idle -= obj->idle_waiters;
+  obj->idle_waiters = 0;
+  obj->cond.notify_all();
+}
+
+// HANDLE points to one of these, thread keeps its own reference
+typedef std::shared_ptr<ShimObject> ShimHandle;
+
+static HANDLE Shim_CreateEvent(void* SA, BOOL manualReset, BOOL initialSig,
+                               const char* ignored)
+{
+  auto h = new ShimHandle(new ShimObject);
+  (*h)->manual_reset = !!manualReset;
+  (*h)->signaled = !!initialSig;
+  return (HANDLE)h;
+}
+
+static BOOL Shim_SetEvent(HANDLE hand)
+{
+  if (!hand)
+    return FALSE;
+  ShimObject* obj = ((ShimHandle*)hand)->get();
+  std::lock_guard<std::mutex> lock(g_mutex);
+  Signal(obj);
+  return TRUE;
+}
+
+static BOOL Shim_ResetEvent(HANDLE hand)
+{
+  if (!hand)
+    return FALSE;
+  ShimObject* obj = ((ShimHandle*)hand)->get();
+  std::lock_guard<std::mutex> lock(g_mutex);
+  obj->signaled = false;
+  return TRUE;
+}
+
+static DWORD Shim_WaitForSingleObject(HANDLE hand, DWORD msTO)
+{
+  if (!hand)
+    return WAIT_FAILED;
+  ShimObject* obj = ((ShimHandle*)hand)->get();
+  std::unique_lock<std::mutex> lock(g_mutex);
+  auto ready = [obj] { return obj->signaled; };
+  if (msTO == INFINITE)
+  {
+    if (t_shim_thread && !obj->signaled)
+    {
+      obj->idle_waiters++;
+      g_idle++;
+      g_idle_cond.notify_all();
+    }
+    obj->cond.wait(lock, ready);
+  }
+  else if (!obj->cond.wait_for(lock, std::chrono::milliseconds(msTO), ready))
+    return WAIT_TIMEOUT;
+  if (!obj->manual_reset)
+    obj->signaled = false;
+  return WAIT_OBJECT_0;
+}
+
+static BOOL Shim_CloseHandle(HANDLE hand)
+{
+  if (!hand)
+    return FALSE;
+  auto h = (ShimHandle*)hand;
+  if ((*h)->thread.joinable())
+    (*h)->thread.detach();
+  delete h;
+  return TRUE;
+}
+
+static HANDLE Shim_CreateThread(void* TA, DWORD stackSize,
+                                DWORD (*ThreadProc)(LPVOID), LPVOID parm,
+                                DWORD cf, DWORD* tidOut)
+{
+  auto h = new ShimHandle(new ShimObject);
+  ShimHandle ref = *h;
+  {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_threads++;
+  }
+  ref->thread = std::thread([ref, ThreadProc, parm] {
+    t_shim_thread = true;
+    ThreadProc(parm);
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_threads--;
+    Signal(ref.get());
+    g_idle_cond.notify_all();
+  });
+  if (tidOut)
+    *tidOut = 0;
+  return (HANDLE)h;
+}
+
+static void Shim_Sleep(int ms)
+{
+  if (!t_shim_thread)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_idle++;
+    g_idle_cond.notify_all();
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+  std::lock_guard<std::mutex> lock(g_mutex);
+  g_idle--;
+}
+
+// dialogs and other UI are not used headless
+static int Shim_Unused()
+{
+  return 0;
+}
+
+static void* Shim_GetFunc(const char* name)
+{
+  static const struct
+  {
+    const char* name;
+    void* func;
+  } funcs[] = {
+    {"CreateEvent", (void*)&Shim_CreateEvent},
+    {"SetEvent", (void*)&Shim_SetEvent},
+    {"ResetEvent", (void*)&Shim_ResetEvent},
+    {"WaitForSingleObject", (void*)&Shim_WaitForSingleObject},
+    {"CloseHandle", (void*)&Shim_CloseHandle},
+    {"CreateThread", (void*)&Shim_CreateThread},
+    {"Sleep", (void*)&Shim_Sleep},
+  };
+  for (auto& f : funcs)
+  {
+    if (!strcmp(f.name, name))
+      return f.func;
+  }
+  return (void*)&Shim_Unused;
+}
+
+bool InitSWELL()
+{
+  return SWELL_dllMain(NULL, DLL_PROCESS_ATTACH, (LPVOID)&Shim_GetFunc) != 0;
+}
+
+bool WaitThreadsIdle(int msTO)
+{
+  std::unique_lock<std::mutex> lock(g_mutex);
+  return g_idle_cond.wait_for(lock, std::chrono::milliseconds(msTO),
+                              [] { return g_idle >= g_threads; });
+}
+
+} // namespace ReaperStub
+
+#endif
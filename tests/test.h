@@ -0,0 +1,36 @@
+#ifndef _TEST_H_
+#define _TEST_H_
+
+#include <stdio.h>
+
+// Minimal checks for tests, main() returns TEST_RESULT()
+static int g_test_failures;
+
+#define CHECK(x)                                                               \
+  do                                                                           \
+  {                                                                            \
+    if (!(x))                                                                  \
+    {                                                                          \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #x);   \
+      g_test_failures++;                                                       \
+    }                                                                          \
+  } while (0)
+
+#define CHECK_EQ(a, b)                                                         \
+  do                                                                           \
+  {                                                                            \
+    long long va_ = (long long)(a), vb_ = (long long)(b);                      \
+    if (va_ != vb_)                                                            \
+    {                                                                          \
+      fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n",        \
+              __FILE__, __LINE__, #a, #b, va_, vb_);                           \
+      g_test_failures++;                                                       \
+    }                                                                          \
+  } while (0)
+
+#define TEST_RESULT()                                                          \
+  (g_test_failures ? (fprintf(stderr, "%d check(s) failed\n", g_test_failures), \
+                      1)                                                       \
+                   : 0)
+
+#endif
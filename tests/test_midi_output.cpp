@@ -0,0 +1,159 @@
+// Threaded MIDI output queue bounds: longest message that fits a slot is
+// sent whole, one byte more is dropped. Coalescing keeps meter overload,
+// short messages keep their order after barrier SysEx and can't hold back
+// other SysEx for long.
+
+#include "reaper_stub.h"
+#include "test.h"
+
+#include "csurf.h"
+
+#include <chrono>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+using namespace ReaMCULive;
+using namespace ReaperStub;
+
+#define DEV 7
+
+static MIDIOutputStats Wait(midi_Output* out)
+{
+  MIDIOutputStats st{};
+  for (int tries = 0; tries < 5000; tries++)
+  {
+    GetThreadedMIDIOutputStats(out, &st);
+    if (!st.queued && st.sent + st.dropped + st.coalesced == st.enqueued)
+      break;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return st;
+}
+
+static std::vector<unsigned char> SysEx(int len)
+{
+  std::vector<unsigned char> msg(len, 0x20);
+  msg[0] = 0xf0;
+  for (int i = 1; i < len - 1; i++)
+    msg[i] = (unsigned char)(i & 0x7f);
+  msg[len - 1] = 0xf7;
+  return msg;
+}
+
+static int Find(const std::vector<std::vector<unsigned char>>& sent,
+                const std::vector<unsigned char>& msg)
+{
+  for (size_t i = 0; i < sent.size(); i++)
+  {
+    if (sent[i] == msg)
+      return (int)i;
+  }
+  return -1;
+}
+
+static void SendMsg(midi_Output* out, const std::vector<unsigned char>& msg)
+{
+  struct
+  {
+    MIDI_event_t evt;
+    unsigned char data[1024];
+  } evt{};
+  evt.evt.size = (int)msg.size();
+  memcpy(evt.evt.midi_message, msg.data(), msg.size());
+  out->SendMsg(&evt.evt, -1);
+}
+
+int main()
+{
+  CHECK(LoadPlugin());
+  if (g_test_failures)
+    return TEST_RESULT();
+
+  // full LCD SysEx fits
+  CHECK(MIDIOUT_MAX_MESSAGE >= 7 + 112 + 1);
+
+  midi_Output* out = CreateThreadedMIDIOutput(CreateFakeMIDIOutput(DEV));
+  SetThreadedMIDIOutputPacing(out, 0.0, 0.0);
+
+  auto limit = SysEx(MIDIOUT_MAX_MESSAGE);
+  SendMsg(out, limit);
+  MIDIOutputStats st = Wait(out);
+  CHECK_EQ(st.sent, 1);
+  CHECK_EQ(st.dropped, 0);
+  auto sent = TakeOutput(DEV);
+  CHECK_EQ(sent.size(), 1);
+  CHECK(!sent.empty() && sent[0] == limit);
+
+  SendMsg(out, SysEx(MIDIOUT_MAX_MESSAGE + 1));
+  st = Wait(out);
+  CHECK_EQ(st.sent, 1);
+  CHECK_EQ(st.dropped, 1);
+  CHECK(TakeOutput(DEV).empty());
+
+  // queue still works after drop
+  SendMsg(out, limit);
+  st = Wait(out);
+  CHECK_EQ(st.sent, 2);
+  CHECK_EQ(TakeOutput(DEV).size(), 1);
+
+  // overload clear queued behind paced LEDs is not replaced by next level
+  SetThreadedMIDIOutputPacing(out, 1000.0, 0.0);
+  SetThreadedMIDIOutputCoalescing(out, true);
+  for (int i = 0; i < 100; i++)
+    SendMsg(out, {0x90, (unsigned char)i, 0x7f});
+  SendMsg(out, {0xd0, 0x1f, 0x00});
+  SendMsg(out, {0xd0, 0x15, 0x00});
+  Wait(out);
+  sent = TakeOutput(DEV);
+  CHECK_EQ(sent.size(), 102);
+  std::vector<unsigned char> clear = {0xd0, 0x1f, 0x00};
+  std::vector<unsigned char> level = {0xd0, 0x15, 0x00};
+  CHECK(sent.size() >= 2 && sent[sent.size() - 2] == clear);
+  CHECK(!sent.empty() && sent.back() == level);
+
+  // LEDs use up byte budget, rest of them stays queued
+  auto fill = [out](int ch) {
+    for (int i = 0; i < 128; i++)
+      SendMsg(out, {(unsigned char)(0x90 | ch), (unsigned char)i, 0x7f});
+  };
+
+  // meter mode SysEx goes after fader queued before it, before overload
+  // clear and fader queued after it
+  SetThreadedMIDIOutputPacing(out, 30000.0, 0.0);
+  fill(2);
+  std::vector<unsigned char> fader1 = {0xe0, 0x00, 0x10};
+  std::vector<unsigned char> fader2 = {0xe0, 0x00, 0x20};
+  std::vector<unsigned char> mode = {0xf0, 0x00, 0x00, 0x66, 0x14,
+                                     0x20, 0x00, 0x03, 0xf7};
+  SendMsg(out, fader1);
+  SendMsg(out, mode);
+  SendMsg(out, {0xd0, 0x0f, 0x00});
+  SendMsg(out, fader2);
+  Wait(out);
+  sent = TakeOutput(DEV);
+  CHECK_EQ(sent.size(), 128 + 4);
+  CHECK(Find(sent, fader1) >= 0 && Find(sent, fader1) < Find(sent, mode));
+  CHECK(Find(sent, mode) < Find(sent, {0xd0, 0x0f, 0x00}));
+  CHECK(Find(sent, mode) < Find(sent, fader2));
+
+  // LCD text is no barrier, shorts queued after it go first but only
+  // MIDIOUT_SYSEX_MAX_BYPASS of them
+  fill(3);
+  std::vector<unsigned char> lcd = {0xf0, 0x00, 0x00, 0x66, 0x14, 0x12,
+                                    0x00, 'a',  'b',  'c',  0xf7};
+  SendMsg(out, lcd);
+  for (int i = 0; i < 100; i++)
+    SendMsg(out, {0x91, (unsigned char)i, 0x7f});
+  Wait(out);
+  sent = TakeOutput(DEV);
+  CHECK_EQ(sent.size(), 128 + 1 + 100);
+  int ahead = 0;
+  for (int i = 0; i < Find(sent, lcd); i++)
+    ahead += sent[i][0] == 0x91;
+  CHECK(Find(sent, lcd) >= 0);
+  CHECK(ahead <= MIDIOUT_SYSEX_MAX_BYPASS);
+
+  delete out;
+  return TEST_RESULT();
+}
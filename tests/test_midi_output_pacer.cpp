@@ -0,0 +1,153 @@
+// MIDIOutputPacer on a fake clock: long run rate, burst size and SysEx gap.
+
+#include "test.h"
+
+#include "midi_output_pacer.hpp"
+
+#include <math.h>
+
+using namespace ReaMCULive;
+
+#define EPS 1e-9
+
+// sends n messages of len bytes each as soon as pacer allows, returns time
+// of last one
+static double SendAll(MIDIOutputPacer& pacer, double now, int n, int len,
+                      bool sysex)
+{
+  for (int i = 0; i < n; i++)
+  {
+    double t = pacer.GetSendTime(len, sysex, now);
+    if (t > now)
+      now = t;
+    pacer.OnSend(len, sysex, now);
+  }
+  return now;
+}
+
+static void TestUnlimited()
+{
+  MIDIOutputPacer pacer;
+  pacer.SetSysExGap(0.0);
+  double now = 10.0;
+  CHECK(SendAll(pacer, now, 10000, 3, false) == now);
+  CHECK(SendAll(pacer, now, 100, 120, true) == now);
+}
+
+static void TestRate()
+{
+  MIDIOutputPacer pacer;
+  pacer.SetSysExGap(0.0);
+  pacer.SetRate(1000.0); // burst is MIDIOUT_BURST_MIN
+  double start = 10.0;
+
+  // full bucket goes at once, rest at rate
+  double end = SendAll(pacer, start, 1000, 3, false);
+  double expect = (1000 * 3 - MIDIOUT_BURST_MIN) / 1000.0;
+  CHECK(fabs((end - start) - expect) < 0.003 + EPS);
+
+  // after idle, same again
+  start = end + 100.0;
+  end = SendAll(pacer, start, 1000, 3, false);
+  CHECK(fabs((end - start) - expect) < 0.003 + EPS);
+
+  // fast rate, bucket is MIDIOUT_BURST_TIME deep
+  pacer.SetRate(100000.0);
+  start = end + 100.0;
+  end = SendAll(pacer, start, 10000, 3, false);
+  expect = (10000 * 3 - 100000.0 * MIDIOUT_BURST_TIME) / 100000.0;
+  CHECK(fabs((end - start) - expect) < 0.0001);
+}
+
+static void TestBurst()
+{
+  MIDIOutputPacer pacer;
+  pacer.SetSysExGap(0.0);
+  pacer.SetRate(1000.0);
+  double now = 10.0;
+
+  // 85 * 3 = 255 bytes fit MIDIOUT_BURST_MIN bucket
+  int n = 0;
+  while (pacer.GetSendTime(3, false, now) <= now && n < 1000)
+  {
+    pacer.OnSend(3, false, now);
+    n++;
+  }
+  CHECK_EQ(n, MIDIOUT_BURST_MIN / 3);
+  // 1 byte left, waits for 2 more
+  CHECK(fabs(pacer.GetSendTime(3, false, now) - (now + 0.002)) < EPS);
+
+  // long idle does not grow bucket past its depth
+  now += 1000.0;
+  n = 0;
+  while (pacer.GetSendTime(3, false, now) <= now && n < 1000)
+  {
+    pacer.OnSend(3, false, now);
+    n++;
+  }
+  CHECK_EQ(n, MIDIOUT_BURST_MIN / 3);
+
+  // depth is MIDIOUT_BURST_TIME of rate when that is more
+  pacer.SetRate(100000.0);
+  now += 1000.0;
+  n = 0;
+  while (pacer.GetSendTime(10, false, now) <= now && n < 1000)
+  {
+    pacer.OnSend(10, false, now);
+    n++;
+  }
+  CHECK_EQ(n, (int)(100000.0 * MIDIOUT_BURST_TIME) / 10);
+
+  // message larger than bucket goes once bucket is full
+  pacer.SetRate(1000.0);
+  now += 1000.0;
+  pacer.OnSend(MIDIOUT_BURST_MIN, false, now);
+  double t = pacer.GetSendTime(MIDIOUT_BURST_MIN * 4, true, now);
+  CHECK(fabs(t - (now + MIDIOUT_BURST_MIN / 1000.0)) < EPS);
+}
+
+static void TestSysExGap()
+{
+  MIDIOutputPacer pacer;
+  double now = 10.0;
+
+  // default gap, rate unlimited
+  CHECK(pacer.GetSendTime(120, true, now) <= now);
+  pacer.OnSend(120, true, now);
+  CHECK(fabs(pacer.GetSendTime(120, true, now) - (now + MIDIOUT_SYSEX_GAP)) <
+        EPS);
+  // short messages are not held by gap
+  CHECK(pacer.GetSendTime(3, false, now) <= now);
+  CHECK(pacer.GetSendTime(120, true, now + MIDIOUT_SYSEX_GAP) <=
+        now + MIDIOUT_SYSEX_GAP);
+
+  // 100 SysEx take 99 gaps
+  pacer.SetSysExGap(0.010);
+  now += 1.0;
+  double end = SendAll(pacer, now, 100, 120, true);
+  CHECK(fabs((end - now) - 99 * 0.010) < EPS);
+
+  // gap and rate together, later of both
+  pacer.SetRate(1000.0);
+  now = end + 100.0;
+  pacer.OnSend(MIDIOUT_BURST_MIN, true, now); // empties bucket
+  double t = pacer.GetSendTime(100, true, now);
+  CHECK(fabs(t - (now + 0.100)) < EPS);
+  pacer.SetSysExGap(0.500);
+  t = pacer.GetSendTime(100, true, now);
+  CHECK(fabs(t - (now + 0.500)) < EPS);
+
+  // negative disables
+  pacer.SetSysExGap(-1.0);
+  pacer.SetRate(0.0);
+  CHECK(pacer.GetSendTime(120, true, now) <= now);
+}
+
+int main()
+{
+  TestUnlimited();
+  TestRate();
+  TestBurst();
+  TestSysExGap();
+  return TEST_RESULT();
+}
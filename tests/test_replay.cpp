@@ -0,0 +1,194 @@
+// Replays MIDI recorded from an MCU (tests/data/mcu_session.txt) into a
+// headless surface and checks what it did to the project and sent back.
+// Trace of the run is dumped to second argument for reamculive_replay.
+
+#include "reaper_stub.h"
+#include "test.h"
+
+#include "surface_trace.hpp"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+using namespace ReaMCULive;
+using namespace ReaperStub;
+
+struct RecordedMessage
+{
+  double time;
+  std::vector<unsigned char> msg;
+};
+
+// "seconds hex hex ...", # starts comment
+static bool ReadSession(const char* fn, std::vector<RecordedMessage>* res)
+{
+  FILE* fp = fopen(fn, "r");
+  if (!fp)
+    return false;
+  char line[1024];
+  while (fgets(line, sizeof(line), fp))
+  {
+    char* p = strchr(line, '#');
+    if (p)
+      *p = 0;
+    RecordedMessage rm;
+    rm.time = strtod(line, &p);
+    if (p == line)
+      continue;
+    for (;;)
+    {
+      char* end;
+      long b = strtol(p, &end, 16);
+      if (end == p)
+        break;
+      rm.msg.push_back((unsigned char)b);
+      p = end;
+    }
+    if (!rm.msg.empty())
+      res->push_back(rm);
+  }
+  fclose(fp);
+  return true;
+}
+
+// device's 2x56 character display as LCD SysEx left it
+struct Display
+{
+  char text[112];
+
+  Display()
+  {
+    memset(text, ' ', sizeof(text));
+  }
+
+  void Apply(const std::vector<unsigned char>& m)
+  {
+    static const unsigned char hdr[] = {0xf0, 0x00, 0x00, 0x66, 0x14, 0x12};
+    if (m.size() < sizeof(hdr) + 2 || memcmp(&m[0], hdr, sizeof(hdr)))
+      return;
+    for (size_t i = 7, pos = m[6]; i + 1 < m.size() && pos < sizeof(text);
+         i++, pos++)
+      text[pos] = (char)m[i];
+  }
+
+  bool Shows(int pos, const char* str) const
+  {
+    return !memcmp(text + pos, str, strlen(str));
+  }
+};
+
+static bool HasMessage(const std::vector<std::vector<unsigned char>>& out,
+                       const std::vector<unsigned char>& m)
+{
+  for (auto& o : out)
+  {
+    if (o == m)
+      return true;
+  }
+  return false;
+}
+
+int main(int argc, char** argv)
+{
+  std::vector<RecordedMessage> session;
+  CHECK(argc > 1 && ReadSession(argv[1], &session));
+  CHECK(session.size() > 0);
+  CHECK(LoadPlugin());
+  if (g_test_failures)
+    return TEST_RESULT();
+
+  SetTrackCount(16);
+  CHECK(CreateSurface(false, 0, 8, 0, 0) != NULL);
+  UpdateAllSurfaces();
+  RunSurfaces();
+  WaitOutput();
+
+  // strip 1 fader of unity gain track, after bank it should be sent again
+  Display lcd;
+  std::vector<unsigned char> unity;
+  for (auto& m : TakeOutput(0))
+  {
+    lcd.Apply(m);
+    if (m.size() == 3 && m[0] == 0xe0)
+      unity = m;
+  }
+  CHECK(lcd.Shows(0, "  01  "));
+  CHECK(!unity.empty());
+
+  std::vector<std::vector<unsigned char>> bank_out;
+  double last = 0.0;
+  for (auto& rm : session)
+  {
+    Advance(rm.time - last);
+    last = rm.time;
+    bool bank = rm.msg[0] == 0x90 && rm.msg[1] == 0x2f && rm.msg[2];
+    SendInput(0, rm.msg.data(), (int)rm.msg.size());
+    RunSurfaces();
+    WaitOutput();
+    auto out = TakeOutput(0);
+    for (auto& m : out)
+      lcd.Apply(m);
+    if (bank)
+      bank_out = out;
+
+    // fader 1 at top before bank
+    if (rm.time == 0.300)
+      CHECK(GetTrack(0)->vol > 1.0);
+  }
+  WaitOutput();
+
+  // fader 1 went back down on track 9 after bank, track 1 kept its level
+  CHECK(GetTrack(0)->vol > 1.0);
+  CHECK(GetTrack(8)->vol < 0.001);
+  CHECK(GetTrack(8)->vol >= 0.0);
+
+  CHECK(GetTrack(1)->mute);
+  CHECK(!GetTrack(0)->mute);
+  CHECK(GetTrack(2)->solo);
+  CHECK(!GetTrack(1)->solo);
+  for (int i = 0; i < GetTrackCount(); i++)
+    CHECK(GetTrack(i)->selected == (i == 3));
+  CHECK(GetTrack(0)->pan > 0.0);
+  CHECK(GetTrack(1)->pan == 0.0);
+
+  // bank right shows tracks 9-16, strip 1 fader moves to track 9
+  CHECK(lcd.Shows(0, "  09  "));
+  CHECK(lcd.Shows(7 * 7, "  16  "));
+  CHECK(HasMessage(bank_out, unity));
+
+  // buttons above 0x32 go to REAPER actions as CC on channel 16
+  CHECK(HasMessage(TakeActionMIDI(), {0xbf, 0x5e, 0x00}));
+
+  // trace has session input in order, stub clock also runs in real time so
+  // gaps can only grow
+  if (argc > 2)
+  {
+    typedef int (*DumpTraceFunc)(int, const char*);
+    auto dump = (DumpTraceFunc)GetPluginAPI("MCULive_DumpTrace");
+    CHECK(dump && dump(0, argv[2]) > 0);
+
+    std::vector<TraceRecord> records;
+    FILE* fp = fopen(argv[2], "rb");
+    CHECK(fp && SurfaceTrace::Read(fp, &records));
+    if (fp)
+      fclose(fp);
+    std::vector<TraceRecord> in;
+    for (auto& rec : records)
+    {
+      if (rec.type == TRACE_IN)
+        in.push_back(rec);
+    }
+    CHECK_EQ(in.size(), session.size());
+    for (size_t i = 0; i < in.size() && i < session.size(); i++)
+    {
+      CHECK_EQ(in[i].size, session[i].msg.size());
+      CHECK(!memcmp(in[i].msg, session[i].msg.data(), in[i].size));
+      CHECK(in[i].time - in[0].time >= session[i].time - 1e-6);
+    }
+  }
+
+  DestroySurfaces();
+  return TEST_RESULT();
+}
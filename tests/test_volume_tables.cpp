@@ -0,0 +1,108 @@
+// volToInt14/volToChar tables against the per call conversion they
+// replaced, DB2SLIDER(VAL2DB(x)) rounded to position. Covers 0, gains
+// under VAL2DB -150 dB floor and both sides of every table edge.
+
+#define REAPERAPI_IMPLEMENT
+#define REAPERAPI_MINIMAL
+#define REAPERAPI_WANT_DB2SLIDER
+#define REAPERAPI_WANT_SLIDER2DB
+
+#include "test.h"
+
+#include "volume_tables.hpp"
+
+#include <math.h>
+#include <vector>
+
+using namespace ReaMCULive;
+
+// Monotonic stand-in for REAPER's fader taper, slider 0..1000 is -190..+12
+// dB so -150 dB (VAL2DB floor) is above slider 0 like on a real taper.
+static double TaperDB2Slider(double x)
+{
+  if (x <= -190.0)
+    return 0.0;
+  return 1000.0 * pow((x + 190.0) / 202.0, 4.0);
+}
+
+static double TaperSlider2DB(double y)
+{
+  if (y <= 0.0)
+    return -190.0;
+  return 202.0 * pow(y / 1000.0, 0.25) - 190.0;
+}
+
+static int OldVolToInt14(double vol)
+{
+  double d = (DB2SLIDER(VAL2DB(vol)) * 16383.0 / 1000.0);
+  if (d < 0.0)
+    d = 0.0;
+  else if (d > 16383.0)
+    d = 16383.0;
+
+  return (int)(d + 0.5);
+}
+
+static int OldVolToChar(double vol)
+{
+  double d = (DB2SLIDER(VAL2DB(vol)) * 127.0 / 1000.0);
+  if (d < 0.0)
+    d = 0.0;
+  else if (d > 127.0)
+    d = 127.0;
+
+  return (int)(d + 0.5);
+}
+
+static int g_mismatches;
+
+static void Check(double vol)
+{
+  int a = volToInt14(vol), b = OldVolToInt14(vol);
+  int c = volToChar(vol), d = OldVolToChar(vol);
+  if ((a != b || c != d) && g_mismatches++ < 10)
+  {
+    fprintf(stderr, "vol %.17g: int14 %d, expected %d, char %d, expected %d\n",
+            vol, a, b, c, d);
+  }
+}
+
+int main()
+{
+  DB2SLIDER = TaperDB2Slider;
+  SLIDER2DB = TaperSlider2DB;
+  InitVolumeTables();
+
+  // stub taper puts -150 dB above position 0, floor must hold
+  CHECK(OldVolToInt14(0.0) > 0);
+  CHECK_EQ(volToInt14(0.0), OldVolToInt14(0.0));
+  CHECK_EQ(volToChar(0.0), OldVolToChar(0.0));
+
+  std::vector<double> vols = {
+    0.0,          -0.0,         -1.0,          -HUGE_VAL,    1e-300,
+    1e-20,        1e-9,         2.98023223876953125e-8,     DB2VAL(-150.0),
+    DB2VAL(-160), DB2VAL(-149), 1.0,           DB2VAL(12.0), DB2VAL(24.0),
+    1e10,         HUGE_VAL,
+  };
+  for (double db = -200.0; db <= 30.0; db += 0.001)
+    vols.push_back(DB2VAL(db));
+  for (int i = 0; i < 16384; i++)
+    vols.push_back(int14ToVolCalc(i));
+  for (int i = 1; i < 16384; i++)
+    vols.push_back(g_vol_int14_edge[i]);
+  for (int i = 1; i < 128; i++)
+    vols.push_back(g_vol_char_edge[i]);
+
+  for (double v : vols)
+  {
+    Check(v);
+    if (isfinite(v))
+    {
+      Check(nextafter(v, -HUGE_VAL));
+      Check(nextafter(v, HUGE_VAL));
+    }
+  }
+  CHECK_EQ(g_mismatches, 0);
+
+  return TEST_RESULT();
+}